@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <wx/grid.h>
+#include <wx/wx.h>
+
+#include "FieldIndex.hpp"
+
+// Grid table that reads the visible cells from the file through a FieldIndex
+class ColumnTable : public wxGridTableBase {
+public:
+  ColumnTable(const std::string &path, const FieldIndex &index);
+
+  void SetRows(std::vector<FieldIndex::RowId> rows);
+  void SetColumnLabel(int col, const wxString &label);
+
+  virtual int GetNumberRows() override;
+  virtual int GetNumberCols() override;
+  virtual wxString GetValue(int row, int col) override;
+  virtual void SetValue(int row, int col, const wxString &value) override;
+  virtual wxString GetRowLabelValue(int row) override;
+  virtual wxString GetColLabelValue(int col) override;
+
+private:
+  const FieldIndex &index;
+  std::ifstream file;
+  std::vector<FieldIndex::RowId> rows;
+  std::vector<wxString> labels;
+
+  // Cells are requested row by row, so remembering the last row read saves
+  // going back to the file for every cell
+  std::optional<FieldIndex::RowId> cachedRow;
+  std::string cachedText;
+};
+
+// Column view of a CSV, TSV or JSON lines file. Parsing, filtering and
+// sorting run on worker threads, only the visible rows are read.
+class ColumnView : public wxGrid {
+public:
+  ColumnView(wxWindow *parent, const std::string &path);
+  ~ColumnView();
+
+private:
+  // How much of the work has to be redone, each stage includes the next
+  enum class Stage { Build, Filter, Sort };
+
+  void StartWorker(Stage stage);
+  void StopWorker();
+  void OnIndexReady(bool success);
+  void OnRowsReady(unsigned generation,
+                   std::optional<std::vector<FieldIndex::RowId>> filtered,
+                   std::vector<FieldIndex::RowId> rows);
+  void UpdateColumnLabels();
+  void NotifyRowsChanged(int oldRows);
+
+  void OnLabelLeftClick(wxGridEvent &event);
+  void OnLabelRightClick(wxGridEvent &event);
+
+  std::string path;
+  FieldIndex index;
+  ColumnTable *table = nullptr;
+
+  // Substring filter per column and the column sorted by, if any
+  std::map<std::size_t, std::string> filters;
+  std::optional<std::size_t> sortColumn;
+  bool sortAscending = true;
+
+  // Rows passing the filters in file order, sorting starts from these.
+  // Invalid until a worker with the current filters has finished.
+  std::vector<FieldIndex::RowId> filteredRows;
+  bool filteredRowsValid = false;
+
+  std::thread worker;
+  std::atomic<bool> cancelWorker = false;
+  unsigned workerGeneration = 0; // Results of older workers are ignored
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <wx/stream.h>
+
+enum class Compression { None, Gzip, Xz, Zstd };
+
+// Detects the compression format of a file from its magic bytes
+Compression DetectCompression(const std::string &path);
+// Guesses the compression format from the file extension (.gz, .xz, .zst)
+Compression CompressionFromExtension(const std::string &path);
+
+std::string GetCompressionName(Compression compression);
+bool IsCompressionSupported(Compression compression);
+
+// These take ownership of the underlying stream and return nullptr if the
+// format is not supported by this build
+std::unique_ptr<wxInputStream>
+OpenDecompressingStream(Compression compression,
+                        std::unique_ptr<wxInputStream> stream);
+std::unique_ptr<wxOutputStream>
+OpenCompressingStream(Compression compression,
+                      std::unique_ptr<wxOutputStream> stream);
@@ -1,28 +1,46 @@
 #pragma once
 
+#include <atomic>
 #include <fstream>
 #include <map>
 #include <optional>
+#include <semaphore>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <wx/fdrepdlg.h>
 #include <wx/stc/stc.h>
 #include <wx/wx.h>
 
+#include "ColumnView.hpp"
+#include "Compression.hpp"
+#include "LineColumnCache.hpp"
+#include "UndoHistory.hpp"
+#include "WrapView.hpp"
+
 class Editor : public wxPanel {
 public:
   Editor(wxWindow *parent);
   Editor(wxWindow *parent, const std::string &path);
+  ~Editor();
 
   void Load(const std::string &path);
   void Save();
   void SaveAs();
   void Close();
   bool IsModified();
+  bool IsLoading() const { return loading; }
+  // Loading stopped early, the text is read-only and cannot be saved
+  bool IsTruncated() const { return truncated; }
   std::string GetTitle();
 
+  bool IsCompressed() const { return compression != Compression::None; }
+  // Whether saving a compressed file writes it back in the same format
+  void SetRecompressOnSave(bool recompress) { recompressOnSave = recompress; }
+  bool GetRecompressOnSave() const { return recompressOnSave; }
+
   void Paste();
   void Copy();
   void Cut();
@@ -31,13 +49,45 @@ public:
   void Find();
   void Replace();
 
+  // Shows the file as aligned columns instead of text, see ColumnView
+  void ShowColumnView(bool show);
+  bool IsColumnViewShown() const;
+  // Large tables open in the column view and cannot be shown as text
+  bool IsColumnViewOnly() const { return columnViewOnly; }
+
+  // Shows the text soft-wrapped at a fixed column, optionally pretty-printed
+  // as JSON, see WrapView
+  void ShowWrapView(bool show, bool prettyPrint = false);
+  bool IsWrapViewShown(bool prettyPrint = false) const;
+  // False while the column or wrap view is shown instead of the text
+  bool IsTextShown() const;
+
+  // Undo memory budget for this editor, see UndoHistory
+  void SetUndoMemoryBudget(std::size_t bytes);
+  std::size_t GetUndoMemoryBudget() const;
+  std::size_t GetUndoMemoryUsage() const;
+  std::size_t GetUndoSpilledBytes() const;
+
 private:
+  bool WriteFile(const std::string &path);
+  void LoadCompressed(const std::string &path);
+  void LoadColumns();
+  void StopLoading();
+  void OnLoadedChunk(const std::string &chunk);
+  enum class LoadResult { Complete, Failed, TooLarge };
+  void OnLoadFinished(LoadResult result);
+  void DiscardColumnView();
+  void ShowView(wxWindow *view);
+
   void DoFindReplace(int searchFlags, const std::string &findText,
                      bool next = false, bool replace = false,
                      const std::string &replaceText = "",
                      bool replaceAll = false);
 
   void OnCaretPositionChanged(wxStyledTextEvent &event);
+  void OnModified(wxStyledTextEvent &event);
+  void OnChange(wxStyledTextEvent &event);
+  void ApplyUndoStep(const UndoHistory::Step &step, bool undo);
 
   void OnFindDialogClose(wxFindDialogEvent &event);
   void OnFind(wxFindDialogEvent &event);
@@ -106,6 +156,24 @@ private:
   wxFindReplaceDialog *replaceDialog = nullptr;
   wxFindReplaceData findReplaceData;
 
+  // Undo history, replaces the unbounded one built into Scintilla
+  UndoHistory undoHistory;
+  bool recordUndo = true;
+  std::string deletedText;
+
+  // Compressed files are decoded on a worker thread and appended in chunks
+  Compression compression = Compression::None;
+  bool recompressOnSave = true;
+  bool loading = false;
+  bool truncated = false; // Failed or stopped early, see OnLoadFinished
+  std::thread loader;
+  std::atomic<bool> cancelLoad = false;
+  std::counting_semaphore<16> loadSlots{16};
+
   wxStyledTextCtrl *textCtrl;
+  ColumnView *columnView = nullptr;
+  bool columnViewOnly = false;
+  WrapView *wrapView = nullptr;
+  LineColumnCache columnCache;
   std::string path;
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Index of the fields in a CSV, TSV or JSON lines file. Only offsets are
+// kept in memory, stored per column: every row has its start offset in the
+// file and every field its start offset relative to the row. Field values
+// are read back from the file when they are needed.
+//
+// Each line is one record, quoted CSV fields spanning several lines are not
+// supported. CSV and TSV files take their column names from the first line,
+// JSON lines files from the keys of the first object.
+class FieldIndex {
+public:
+  enum class Format { Csv, Tsv, JsonLines };
+  using RowId = std::uint32_t;
+
+  // Format for the .csv, .tsv/.tab and .jsonl/.ndjson extensions
+  static std::optional<Format> FormatFromExtension(const std::string &path);
+  // Same, but guesses from the first line for other extensions
+  static Format DetectFormat(const std::string &path);
+
+  // Parses the file on worker threads, returns false if cancelled or the
+  // file could not be read
+  bool Build(const std::string &path, Format format,
+             const std::atomic<bool> &cancel);
+
+  std::size_t GetRowCount() const;
+  std::size_t GetColumnCount() const { return columns.size(); }
+  const std::string &GetColumnName(std::size_t column) const {
+    return columns[column].name;
+  }
+
+  std::string ReadRow(std::ifstream &file, RowId row) const;
+  std::string GetField(std::string_view text, RowId row,
+                       std::size_t column) const;
+
+  // Rows matching all filters (substring match on a column), in file order
+  std::vector<RowId>
+  Filter(const std::vector<std::pair<std::size_t, std::string>> &filters,
+         const std::atomic<bool> &cancel) const;
+  // Sorts rows by a column, numbers compare numerically
+  void Sort(std::vector<RowId> &rows, std::size_t column, bool ascending,
+            const std::atomic<bool> &cancel) const;
+
+private:
+  struct Column {
+    std::string name;
+    std::vector<std::uint32_t> starts;
+  };
+
+  static constexpr std::uint32_t missing = UINT32_MAX;
+
+  static std::size_t GetWorkerCount();
+
+  void ParseHeader(std::string_view line);
+  void ParseRow(std::string_view line, std::vector<std::uint32_t> &fields,
+                std::vector<std::vector<std::uint32_t>> &starts) const;
+  std::string ExtractValue(std::string_view text) const;
+
+  // Calls fn for every row on up to GetWorkerCount() threads, each thread
+  // gets a contiguous range of rows
+  void
+  ScanRows(const std::function<void(std::size_t worker, RowId row,
+                                    std::string_view text)> &fn,
+           const std::atomic<bool> &cancel) const;
+
+  std::string path;
+  Format format = Format::Csv;
+  std::vector<std::uint64_t> rowOffsets; // One past the last row at the end
+  std::vector<Column> columns;
+  std::unordered_map<std::string, std::size_t> columnsByKey;
+};
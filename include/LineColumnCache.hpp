@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <wx/stc/stc.h>
+
+// Faster replacement for wxStyledTextCtrl::GetColumn on very long lines.
+// GetColumn counts from the start of the line on every call, this remembers
+// the column at every chunkSize bytes of the current line so only the tail
+// of the last chunk has to be counted.
+class LineColumnCache {
+public:
+  explicit LineColumnCache(wxStyledTextCtrl *textCtrl) : textCtrl(textCtrl) {}
+
+  int GetColumn(int pos);
+  // Must be called for every insertion and deletion
+  void Invalidate(int pos, bool linesChanged);
+
+  // Lines shorter than this go straight to GetColumn
+  static constexpr int chunkSize = 64 * 1024;
+
+private:
+  int CountColumns(int start, int end, int column) const;
+
+  wxStyledTextCtrl *textCtrl;
+  int line = -1;
+  std::vector<int> checkpoints; // Column at each multiple of chunkSize
+};
@@ -9,6 +9,15 @@
 
 #include "Editor.hpp"
 
+enum {
+  ID_VIEW_COLUMNS = wxID_HIGHEST + 1,
+  ID_VIEW_WRAP,
+  ID_VIEW_PRETTY_JSON,
+  ID_FILE_RECOMPRESS,
+  ID_EDIT_UNDO_BUDGET,
+  ID_EDIT_UNDO_PROCESS_BUDGET,
+};
+
 class MainFrame : public wxFrame {
 public:
   MainFrame();
@@ -17,10 +26,12 @@ private:
   wxMenuBar *CreateMenuBar();
   void CreateFileMenu();
   void CreateEditMenu();
+  void CreateViewMenu();
 
   std::optional<std::string> ShowOpenFileDialog();
   void SelectionChanged();
   void AddEditor(Editor *editor);
+  void UpdateUndoStatus(Editor *editor);
 
   void OnFileNew(wxCommandEvent &event);
   void OnFileOpen(wxCommandEvent &event);
@@ -28,6 +39,7 @@ private:
   void OnFileCloseAll(wxCommandEvent &event);
   void OnFileSave(wxCommandEvent &event);
   void OnFileSaveAs(wxCommandEvent &event);
+  void OnFileRecompress(wxCommandEvent &event);
   void OnFileQuit(wxCommandEvent &event);
 
   void OnEditUndo(wxCommandEvent &event);
@@ -37,6 +49,13 @@ private:
   void OnEditPaste(wxCommandEvent &event);
   void OnEditFind(wxCommandEvent &event);
   void OnEditReplace(wxCommandEvent &event);
+  void OnEditUndoBudget(wxCommandEvent &event);
+  void OnEditUndoProcessBudget(wxCommandEvent &event);
+
+  void OnViewColumns(wxCommandEvent &event);
+  void OnViewWrap(wxCommandEvent &event);
+  void OnViewPrettyJson(wxCommandEvent &event);
+  void OnMenuOpen(wxMenuEvent &event);
 
   void OnSelectionChanged(wxNotebookEvent &event);
   void OnEditorChanged(wxStyledTextEvent &event);
@@ -45,6 +64,7 @@ private:
 
   wxMenu *fileMenu;
   wxMenu *editMenu;
+  wxMenu *viewMenu;
   wxNotebook *notebook;
   std::vector<Editor *> editors;
 
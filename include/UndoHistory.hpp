@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Undo/redo history with a bounded memory footprint. Recent steps are kept
+// as plain text; once the history grows past its budget (or the process
+// wide budget is exceeded) the oldest steps are zlib-compressed into blocks,
+// and if that is still not enough the oldest blocks are spilled to a
+// temporary file. Nothing is ever thrown away, blocks are only brought back
+// into memory one at a time when undo actually reaches them.
+//
+// Trimming goes down to lowWaterPercent of the budget rather than just
+// below it, so stepping back and forth at the limit does not pack and
+// unpack a block on every step.
+class UndoHistory {
+public:
+  struct Change {
+    enum class Kind { Insert, Delete };
+
+    Kind kind;
+    int position;
+    std::string text;
+  };
+
+  // One undo step, possibly made of several changes (e.g. replace all)
+  using Step = std::vector<Change>;
+
+  UndoHistory();
+  ~UndoHistory();
+
+  UndoHistory(const UndoHistory &) = delete;
+  UndoHistory &operator=(const UndoHistory &) = delete;
+
+  void Record(Change::Kind kind, int position, const std::string &text);
+  void Seal();
+  void BeginGroup();
+  void EndGroup();
+
+  std::optional<Step> Undo();
+  std::optional<Step> Redo();
+  bool CanUndo() const;
+  bool CanRedo() const;
+
+  void Clear();
+  void SetSavePoint();
+  bool IsSavePoint() const;
+
+  void SetBudget(std::size_t bytes);
+  std::size_t GetBudget() const { return budget; }
+
+  // Bytes held in memory (plain steps plus compressed blocks)
+  std::size_t GetMemoryUsage() const { return residentBytes + packedBytes; }
+  // Size of the spill file on disk
+  std::size_t GetSpilledBytes() const { return spillFileSize; }
+
+  static void SetProcessBudget(std::size_t bytes);
+  static std::size_t GetProcessBudget() { return processBudget; }
+  static std::size_t GetProcessMemoryUsage() { return processUsage; }
+
+  static constexpr std::size_t defaultBudget = 16 * 1024 * 1024;
+  static constexpr std::size_t defaultProcessBudget = 128 * 1024 * 1024;
+  static constexpr std::size_t lowWaterPercent = 75;
+
+private:
+  struct Block {
+    std::size_t stepCount;
+    std::string data; // Compressed steps, empty once spilled
+    long offset = -1; // Position in the spill file, -1 if in memory
+    std::size_t length = 0;
+  };
+
+  static std::size_t ChangeSize(const Change &change);
+  static std::size_t StepSize(const Step &step);
+  static std::string Pack(const std::deque<Step> &steps, std::size_t count);
+  static std::vector<Step> Unpack(const std::string &data);
+
+  std::size_t Depth() const { return archivedSteps + undoSteps.size(); }
+  bool OverBudget(std::size_t percent) const;
+  void Trim();
+  std::size_t Archive(std::deque<Step> &steps, std::vector<Block> &target,
+                      std::size_t &restored, bool partial);
+  bool Spill(std::vector<Block> &source);
+  long AllocateSpill(std::size_t length);
+  void FreeSpill(long offset, std::size_t length);
+  void CloseSpill();
+  void DropBlocks(std::vector<Block> &dropped);
+  std::size_t Restore(std::vector<Block> &source, std::deque<Step> &steps);
+  bool RestoreUndo();
+  bool RestoreRedo();
+  void ClearRedo();
+  void AddResident(const Step &step);
+  void RemoveResident(const Step &step);
+  void Account(std::size_t &counter, std::size_t add, std::size_t remove);
+
+  // Undo and redo sides are both ordered from the step furthest from the
+  // current state to the nearest one, packed blocks before plain steps
+  std::vector<Block> blocks;
+  std::size_t archivedSteps = 0;
+  std::deque<Step> undoSteps;
+  std::vector<Block> redoBlocks;
+  std::deque<Step> redoSteps;
+
+  // Steps at the front of undoSteps and redoSteps that were unpacked by the
+  // last restore, they are not packed again right away
+  std::size_t restoredUndo = 0;
+  std::size_t restoredRedo = 0;
+
+  bool sealed = true;
+  int groupDepth = 0;
+  std::optional<std::size_t> savePoint = 0;
+
+  std::size_t budget = defaultBudget;
+  std::size_t residentBytes = 0;
+  std::size_t packedBytes = 0;
+  std::size_t spilledBytes = 0; // Live blocks in the spill file
+  std::FILE *spillFile = nullptr;
+  std::size_t spillFileSize = 0;
+  long spillEnd = 0;                    // End of the space in use
+  std::map<long, std::size_t> freeSpill; // Reusable space by offset
+
+  static std::size_t processBudget;
+  static std::size_t processUsage;
+};
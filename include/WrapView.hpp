@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <wx/vscroll.h>
+#include <wx/wx.h>
+
+// Read-only view for files with very long lines. Lines are soft-wrapped at
+// a fixed column using an index of row starts built on a worker thread, and
+// only the visible rows are drawn. Optionally pretty-prints JSON first.
+//
+// The text is not copied, it must stay unchanged while the view exists.
+class WrapView : public wxVScrolledWindow {
+public:
+  WrapView(wxWindow *parent, std::string_view text, bool prettyPrint,
+           std::size_t wrapColumn = 120);
+  ~WrapView();
+
+  bool IsPrettyPrinted() const { return prettyPrint; }
+
+private:
+  virtual wxCoord OnGetRowHeight(size_t row) const override;
+
+  void OnReady();
+  void OnPaint(wxPaintEvent &event);
+  void OnKeyDown(wxKeyEvent &event);
+
+  bool prettyPrint;
+  std::size_t wrapColumn;
+  wxCoord rowHeight;
+
+  bool ready = false;
+  std::string_view source;
+  std::string formatted; // Pretty-printed copy of source, if enabled
+  std::string_view text; // What is shown, source or formatted
+  std::vector<std::size_t> rowStarts; // One past the last row at the end
+
+  // Written by the worker, moved into formatted and rowStarts by OnReady
+  std::string pendingFormatted;
+  std::vector<std::size_t> pendingRowStarts;
+
+  std::thread worker;
+  std::atomic<bool> cancelWorker = false;
+};
@@ -0,0 +1,245 @@
+#include "ColumnView.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+#include <wx/textdlg.h>
+
+ColumnTable::ColumnTable(const std::string &path, const FieldIndex &index)
+    : index(index), file(path, std::ios::binary),
+      labels(index.GetColumnCount()) {}
+
+void ColumnTable::SetRows(std::vector<FieldIndex::RowId> rows) {
+  this->rows = std::move(rows);
+}
+
+void ColumnTable::SetColumnLabel(int col, const wxString &label) {
+  labels[col] = label;
+}
+
+int ColumnTable::GetNumberRows() {
+  return static_cast<int>(std::min<std::size_t>(rows.size(), INT_MAX));
+}
+
+int ColumnTable::GetNumberCols() {
+  return static_cast<int>(index.GetColumnCount());
+}
+
+wxString ColumnTable::GetValue(int row, int col) {
+  auto id = rows[row];
+  if (cachedRow != id) {
+    cachedText = index.ReadRow(file, id);
+    cachedRow = id;
+  }
+
+  return wxString::FromUTF8(index.GetField(cachedText, id, col));
+}
+
+void ColumnTable::SetValue([[maybe_unused]] int row, [[maybe_unused]] int col,
+                           [[maybe_unused]] const wxString &value) {
+  // The view is read-only
+}
+
+wxString ColumnTable::GetRowLabelValue(int row) {
+  return wxString::Format(wxT("%u"), rows[row] + 1);
+}
+
+wxString ColumnTable::GetColLabelValue(int col) { return labels[col]; }
+
+ColumnView::ColumnView(wxWindow *parent, const std::string &path)
+    : wxGrid(parent, wxID_ANY), path(path) {
+  EnableEditing(false);
+  SetDefaultColSize(150);
+
+  Bind(wxEVT_GRID_LABEL_LEFT_CLICK, &ColumnView::OnLabelLeftClick, this);
+  Bind(wxEVT_GRID_LABEL_RIGHT_CLICK, &ColumnView::OnLabelRightClick, this);
+
+  StartWorker(Stage::Build);
+}
+
+ColumnView::~ColumnView() { StopWorker(); }
+
+void ColumnView::StartWorker(Stage stage) {
+  StopWorker();
+  cancelWorker = false;
+  auto generation = ++workerGeneration;
+
+  if (stage != Stage::Sort) {
+    filteredRowsValid = false;
+  } else if (!filteredRowsValid) {
+    stage = Stage::Filter;
+  }
+
+  if (table) {
+    UpdateColumnLabels();
+  }
+
+  std::vector<std::pair<std::size_t, std::string>> filterList(filters.begin(),
+                                                              filters.end());
+
+  // Sorting alone starts from a copy of the cached filter result
+  std::vector<FieldIndex::RowId> rows;
+  if (stage == Stage::Sort) {
+    rows = filteredRows;
+  }
+
+  worker = std::thread([this, stage, generation, filterList,
+                        rows = std::move(rows), sortColumn = sortColumn,
+                        sortAscending = sortAscending]() mutable {
+    if (stage == Stage::Build) {
+      bool success =
+          index.Build(path, FieldIndex::DetectFormat(path), cancelWorker);
+      if (cancelWorker) {
+        return;
+      }
+
+      CallAfter([this, success] { OnIndexReady(success); });
+      if (!success) {
+        return;
+      }
+    }
+
+    std::optional<std::vector<FieldIndex::RowId>> filtered;
+    if (stage != Stage::Sort) {
+      // Without filters every row passes, no need to read the file
+      if (filterList.empty()) {
+        filtered.emplace(index.GetRowCount());
+        std::iota(filtered->begin(), filtered->end(), 0);
+      } else {
+        filtered = index.Filter(filterList, cancelWorker);
+      }
+      rows = filtered.value();
+    }
+
+    if (sortColumn) {
+      index.Sort(rows, sortColumn.value(), sortAscending, cancelWorker);
+    }
+
+    if (cancelWorker) {
+      return;
+    }
+
+    CallAfter([this, generation, filtered = std::move(filtered),
+               rows = std::move(rows)]() mutable {
+      OnRowsReady(generation, std::move(filtered), std::move(rows));
+    });
+  });
+}
+
+void ColumnView::StopWorker() {
+  cancelWorker = true;
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+void ColumnView::OnIndexReady(bool success) {
+  if (!success) {
+    wxMessageBox(wxT("The file could not be read"), wxT("Column View"),
+                 wxOK | wxICON_ERROR);
+    return;
+  }
+
+  table = new ColumnTable(path, index);
+  SetTable(table, true);
+  UpdateColumnLabels();
+}
+
+void ColumnView::OnRowsReady(
+    unsigned generation, std::optional<std::vector<FieldIndex::RowId>> filtered,
+    std::vector<FieldIndex::RowId> rows) {
+  if (!table || generation != workerGeneration) {
+    return;
+  }
+
+  if (filtered) {
+    filteredRows = std::move(filtered.value());
+    filteredRowsValid = true;
+  }
+
+  auto oldRows = table->GetNumberRows();
+  table->SetRows(std::move(rows));
+  NotifyRowsChanged(oldRows);
+}
+
+void ColumnView::NotifyRowsChanged(int oldRows) {
+  auto newRows = table->GetNumberRows();
+
+  BeginBatch();
+  if (newRows < oldRows) {
+    wxGridTableMessage message(table, wxGRIDTABLE_NOTIFY_ROWS_DELETED,
+                               newRows, oldRows - newRows);
+    ProcessTableMessage(message);
+  } else if (newRows > oldRows) {
+    wxGridTableMessage message(table, wxGRIDTABLE_NOTIFY_ROWS_APPENDED,
+                               newRows - oldRows);
+    ProcessTableMessage(message);
+  }
+  EndBatch();
+
+  ForceRefresh();
+}
+
+void ColumnView::UpdateColumnLabels() {
+  for (std::size_t col = 0; col < index.GetColumnCount(); col++) {
+    auto label = wxString::FromUTF8(index.GetColumnName(col));
+
+    if (sortColumn == col) {
+      label += sortAscending ? wxString::FromUTF8(" ▲")
+                             : wxString::FromUTF8(" ▼");
+    }
+
+    auto filter = filters.find(col);
+    if (filter != filters.end()) {
+      label += wxT(" [") + wxString::FromUTF8(filter->second) + wxT("]");
+    }
+
+    table->SetColumnLabel(static_cast<int>(col), label);
+  }
+
+  ForceRefresh();
+}
+
+void ColumnView::OnLabelLeftClick(wxGridEvent &event) {
+  auto col = event.GetCol();
+  if (col < 0) {
+    return;
+  }
+
+  // Clicking the sorted column again reverses the order
+  if (sortColumn == static_cast<std::size_t>(col)) {
+    sortAscending = !sortAscending;
+  } else {
+    sortColumn = col;
+    sortAscending = true;
+  }
+
+  StartWorker(Stage::Sort);
+}
+
+void ColumnView::OnLabelRightClick(wxGridEvent &event) {
+  auto col = event.GetCol();
+  if (col < 0) {
+    return;
+  }
+
+  auto current = filters.find(col);
+  auto text = wxGetTextFromUser(
+      wxT("Show rows where this column contains (empty to show all):"),
+      wxT("Filter Column"),
+      current != filters.end() ? wxString::FromUTF8(current->second)
+                               : wxString(),
+      this);
+
+  auto previous = filters;
+  if (text.empty()) {
+    filters.erase(col);
+  } else {
+    filters[col] = std::string(text.utf8_str());
+  }
+
+  if (filters != previous) {
+    StartWorker(Stage::Filter);
+  }
+}
@@ -0,0 +1,348 @@
+#include "Compression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <fstream>
+#include <initializer_list>
+#include <vector>
+
+#include <wx/zstream.h>
+#include <zlib.h>
+
+// wxLZMA streams are only available since wxWidgets 3.1.2 and only when
+// wxWidgets was built against liblzma
+#if wxCHECK_VERSION(3, 1, 2)
+#include <wx/lzmastream.h>
+#endif
+
+#if wxCHECK_VERSION(3, 1, 2) && wxUSE_LZMA
+#define TED_HAVE_LZMA 1
+#else
+#define TED_HAVE_LZMA 0
+#endif
+
+// zstd is not bundled with wxWidgets, CMake defines this when libzstd is found
+#ifndef TED_HAVE_ZSTD
+#define TED_HAVE_ZSTD 0
+#endif
+
+// Decodes gzip data made of one or more members. Concatenated .gz files,
+// bgzip and most log rotation tools write several members, while
+// wxZlibInputStream stops at the end of the first one.
+class GzipInputStream : public wxFilterInputStream {
+public:
+  explicit GzipInputStream(wxInputStream *stream)
+      : wxFilterInputStream(stream), input(inputSize) {
+    // Adding 32 detects gzip and zlib headers, like wxZLIB_AUTO
+    if (inflateInit2(&context, MAX_WBITS + 32) != Z_OK) {
+      m_lasterror = wxSTREAM_READ_ERROR;
+    }
+  }
+  ~GzipInputStream() { inflateEnd(&context); }
+
+protected:
+  size_t OnSysRead(void *buffer, size_t size) override {
+    context.next_out = static_cast<Bytef *>(buffer);
+    context.avail_out = static_cast<uInt>(std::min<size_t>(size, UINT_MAX));
+    auto wanted = context.avail_out;
+
+    while (context.avail_out > 0) {
+      if (context.avail_in == 0 && !Refill()) {
+        break;
+      }
+
+      if (memberEnded) {
+        // Like gzip, ignore anything after the last member that does not
+        // start another one, e.g. zero padding
+        if (context.next_in[0] != 0x1f) {
+          finished = true;
+          break;
+        }
+        inflateReset(&context);
+        memberEnded = false;
+      }
+
+      auto result = inflate(&context, Z_NO_FLUSH);
+      if (result == Z_STREAM_END) {
+        memberEnded = true;
+      } else if (result != Z_OK) {
+        m_lasterror = wxSTREAM_READ_ERROR;
+        break;
+      }
+    }
+
+    auto count = wanted - context.avail_out;
+    if (count == 0 && m_lasterror == wxSTREAM_NO_ERROR) {
+      // Running out of input in the middle of a member means a truncated file
+      m_lasterror =
+          memberEnded || finished ? wxSTREAM_EOF : wxSTREAM_READ_ERROR;
+    }
+
+    return count;
+  }
+
+private:
+  static constexpr std::size_t inputSize = 256 * 1024;
+
+  bool Refill() {
+    if (finished) {
+      return false;
+    }
+
+    m_parent_i_stream->Read(input.data(), input.size());
+    auto count = m_parent_i_stream->LastRead();
+    if (count == 0) {
+      if (!m_parent_i_stream->Eof()) {
+        m_lasterror = wxSTREAM_READ_ERROR;
+      }
+      return false;
+    }
+
+    context.next_in = reinterpret_cast<Bytef *>(input.data());
+    context.avail_in = static_cast<uInt>(count);
+    return true;
+  }
+
+  z_stream context{};
+  std::vector<char> input;
+  bool memberEnded = false;
+  bool finished = false;
+};
+
+#if TED_HAVE_ZSTD
+#include <thread>
+
+#include <zstd.h>
+
+// Decodes a zstd stream of one or more frames
+class ZstdInputStream : public wxFilterInputStream {
+public:
+  explicit ZstdInputStream(wxInputStream *stream)
+      : wxFilterInputStream(stream), context(ZSTD_createDStream()),
+        input(ZSTD_DStreamInSize()) {}
+  ~ZstdInputStream() { ZSTD_freeDStream(context); }
+
+protected:
+  size_t OnSysRead(void *buffer, size_t size) override {
+    ZSTD_outBuffer out{buffer, size, 0};
+
+    while (out.pos < out.size) {
+      // A full output buffer means the decoder may still hold data, so
+      // it has to be drained before more input is read
+      if (in.pos == in.size && !outputPending && !Refill()) {
+        break;
+      }
+
+      auto result = ZSTD_decompressStream(context, &out, &in);
+      if (ZSTD_isError(result)) {
+        m_lasterror = wxSTREAM_READ_ERROR;
+        return out.pos;
+      }
+      frameEnded = result == 0;
+      outputPending = !frameEnded && out.pos == out.size;
+    }
+
+    if (out.pos == 0 && m_lasterror == wxSTREAM_NO_ERROR) {
+      // Running out of input in the middle of a frame means a truncated file
+      m_lasterror = frameEnded ? wxSTREAM_EOF : wxSTREAM_READ_ERROR;
+    }
+
+    return out.pos;
+  }
+
+private:
+  bool Refill() {
+    m_parent_i_stream->Read(input.data(), input.size());
+    auto count = m_parent_i_stream->LastRead();
+    if (count == 0) {
+      if (!m_parent_i_stream->Eof()) {
+        m_lasterror = wxSTREAM_READ_ERROR;
+      }
+      return false;
+    }
+
+    in = {input.data(), count, 0};
+    return true;
+  }
+
+  ZSTD_DStream *context;
+  std::vector<char> input;
+  ZSTD_inBuffer in{nullptr, 0, 0};
+  bool outputPending = false;
+  bool frameEnded = true;
+};
+
+class ZstdOutputStream : public wxFilterOutputStream {
+public:
+  explicit ZstdOutputStream(wxOutputStream *stream)
+      : wxFilterOutputStream(stream), context(ZSTD_createCCtx()),
+        output(ZSTD_CStreamOutSize()) {
+    ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel,
+                           ZSTD_CLEVEL_DEFAULT);
+    // Only takes effect if libzstd was built with multithreading
+    ZSTD_CCtx_setParameter(context, ZSTD_c_nbWorkers,
+                           static_cast<int>(std::thread::hardware_concurrency()));
+  }
+
+  ~ZstdOutputStream() {
+    Close();
+    ZSTD_freeCCtx(context);
+  }
+
+  bool Close() override {
+    if (!closed) {
+      closed = true;
+      Compress(nullptr, 0, ZSTD_e_end);
+    }
+    return wxFilterOutputStream::Close() && IsOk();
+  }
+
+protected:
+  size_t OnSysWrite(const void *buffer, size_t size) override {
+    return Compress(buffer, size, ZSTD_e_continue) ? size : 0;
+  }
+
+private:
+  bool Compress(const void *data, size_t size, ZSTD_EndDirective mode) {
+    ZSTD_inBuffer in{data, size, 0};
+
+    while (true) {
+      ZSTD_outBuffer out{output.data(), output.size(), 0};
+      auto remaining = ZSTD_compressStream2(context, &out, &in, mode);
+      if (ZSTD_isError(remaining)) {
+        m_lasterror = wxSTREAM_WRITE_ERROR;
+        return false;
+      }
+
+      m_parent_o_stream->Write(output.data(), out.pos);
+      if (m_parent_o_stream->LastWrite() != out.pos) {
+        m_lasterror = wxSTREAM_WRITE_ERROR;
+        return false;
+      }
+
+      if (mode == ZSTD_e_end ? remaining == 0 : in.pos == in.size) {
+        return true;
+      }
+    }
+  }
+
+  ZSTD_CCtx *context;
+  std::vector<char> output;
+  bool closed = false;
+};
+#endif
+
+static bool HasMagic(const std::array<unsigned char, 6> &header,
+                     std::initializer_list<unsigned char> magic) {
+  return std::equal(magic.begin(), magic.end(), header.begin());
+}
+
+Compression DetectCompression(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  std::array<unsigned char, 6> header{};
+  file.read(reinterpret_cast<char *>(header.data()), header.size());
+
+  if (file.gcount() >= 2 && HasMagic(header, {0x1f, 0x8b})) {
+    return Compression::Gzip;
+  }
+  if (file.gcount() >= 6 &&
+      HasMagic(header, {0xfd, '7', 'z', 'X', 'Z', 0x00})) {
+    return Compression::Xz;
+  }
+  if (file.gcount() >= 4 && HasMagic(header, {0x28, 0xb5, 0x2f, 0xfd})) {
+    return Compression::Zstd;
+  }
+
+  return Compression::None;
+}
+
+Compression CompressionFromExtension(const std::string &path) {
+  auto pos = path.find_last_of('.');
+  if (pos == std::string::npos) {
+    return Compression::None;
+  }
+
+  auto extension = path.substr(pos + 1);
+  if (extension == "gz") {
+    return Compression::Gzip;
+  }
+  if (extension == "xz") {
+    return Compression::Xz;
+  }
+  if (extension == "zst") {
+    return Compression::Zstd;
+  }
+
+  return Compression::None;
+}
+
+std::string GetCompressionName(Compression compression) {
+  switch (compression) {
+  case Compression::Gzip:
+    return "gzip";
+  case Compression::Xz:
+    return "xz";
+  case Compression::Zstd:
+    return "zstd";
+  default:
+    return "none";
+  }
+}
+
+bool IsCompressionSupported(Compression compression) {
+  switch (compression) {
+  case Compression::None:
+  case Compression::Gzip:
+    return true;
+  case Compression::Xz:
+    return TED_HAVE_LZMA;
+  case Compression::Zstd:
+    return TED_HAVE_ZSTD;
+  default:
+    return false;
+  }
+}
+
+std::unique_ptr<wxInputStream>
+OpenDecompressingStream(Compression compression,
+                        std::unique_ptr<wxInputStream> stream) {
+  switch (compression) {
+  case Compression::None:
+    return stream;
+  case Compression::Gzip:
+    return std::make_unique<GzipInputStream>(stream.release());
+#if TED_HAVE_LZMA
+  case Compression::Xz:
+    return std::make_unique<wxLZMAInputStream>(stream.release());
+#endif
+#if TED_HAVE_ZSTD
+  case Compression::Zstd:
+    return std::make_unique<ZstdInputStream>(stream.release());
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+std::unique_ptr<wxOutputStream>
+OpenCompressingStream(Compression compression,
+                      std::unique_ptr<wxOutputStream> stream) {
+  switch (compression) {
+  case Compression::None:
+    return stream;
+  case Compression::Gzip:
+    return std::make_unique<wxZlibOutputStream>(
+        stream.release(), wxZ_DEFAULT_COMPRESSION, wxZLIB_GZIP);
+#if TED_HAVE_LZMA
+  case Compression::Xz:
+    return std::make_unique<wxLZMAOutputStream>(stream.release());
+#endif
+#if TED_HAVE_ZSTD
+  case Compression::Zstd:
+    return std::make_unique<ZstdOutputStream>(stream.release());
+#endif
+  default:
+    return nullptr;
+  }
+}
@@ -1,25 +1,53 @@
 #include "Editor.hpp"
 
+#include <chrono>
+#include <filesystem>
+#include <limits>
+
 #include <wx/event.h>
 #include <wx/fdrepdlg.h>
+#include <wx/filename.h>
 #include <wx/notebook.h>
 #include <wx/stc/stc.h>
+#include <wx/wfstream.h>
+
+// Size of the decompressed chunks appended while loading a compressed file
+static constexpr std::size_t loadChunkSize = 4 * 1024 * 1024;
+
+// Scintilla addresses the text with int positions
+static constexpr std::size_t maxLoadSize = std::numeric_limits<int>::max();
 
-Editor::Editor(wxWindow *parent) : wxPanel(parent) {
+// CSV, TSV and JSON lines files larger than this open in the column view
+// only, without loading them into the text control
+static constexpr std::uintmax_t columnViewThreshold = 64 * 1024 * 1024;
+
+Editor::Editor(wxWindow *parent)
+    : wxPanel(parent), textCtrl(new wxStyledTextCtrl(this, wxID_ANY)),
+      columnCache(textCtrl) {
   auto sizer = new wxBoxSizer(wxVERTICAL);
-  textCtrl = new wxStyledTextCtrl(this, wxID_ANY);
   sizer->Add(textCtrl, 1, wxEXPAND);
   SetSizerAndFit(sizer);
 
   textCtrl->Bind(wxEVT_STC_UPDATEUI, &Editor::OnCaretPositionChanged, this);
+  textCtrl->Bind(wxEVT_STC_MODIFIED, &Editor::OnModified, this);
+  textCtrl->Bind(wxEVT_STC_CHANGE, &Editor::OnChange, this);
+
+  // Undo is handled by UndoHistory, keep Scintilla from collecting its own
+  textCtrl->SetUndoCollection(false);
+  textCtrl->CmdKeyClear('Z', wxSTC_KEYMOD_CTRL);
+  textCtrl->CmdKeyClear('Y', wxSTC_KEYMOD_CTRL);
+  textCtrl->CmdKeyClear('Z', wxSTC_KEYMOD_CTRL | wxSTC_KEYMOD_SHIFT);
+  textCtrl->CmdKeyClear(WXK_BACK, wxSTC_KEYMOD_ALT);
 }
 
 Editor::Editor(wxWindow *parent, const std::string &path) : Editor(parent) {
   Load(path);
 }
 
+Editor::~Editor() { StopLoading(); }
+
 void Editor::Close() {
-  if (!textCtrl->GetModify()) {
+  if (!IsModified()) {
     return;
   }
 
@@ -29,11 +57,163 @@ void Editor::Close() {
 }
 
 void Editor::Load(const std::string &path) {
+  StopLoading();
   this->path = path;
+  truncated = false;
+
+  compression = DetectCompression(path);
+  if (compression != Compression::None) {
+    LoadCompressed(path);
+    return;
+  }
+
+  std::error_code error;
+  auto size = std::filesystem::file_size(path, error);
+  if (FieldIndex::FormatFromExtension(path) && !error &&
+      size > columnViewThreshold) {
+    LoadColumns();
+    return;
+  }
+
+  recordUndo = false;
   textCtrl->LoadFile(path);
+  recordUndo = true;
+
+  undoHistory.Clear();
+}
+
+void Editor::LoadCompressed(const std::string &path) {
+  if (!IsCompressionSupported(compression)) {
+    auto message = wxString::Format(
+        wxT("%s compressed files are not supported by this build"),
+        GetCompressionName(compression));
+    wxMessageBox(message, wxT("Open File"), wxOK | wxICON_ERROR);
+    compression = Compression::None;
+    return;
+  }
+
+  loading = true;
+  cancelLoad = false;
+
+  recordUndo = false;
+  textCtrl->ClearAll();
+  textCtrl->SetReadOnly(true);
+
+  // Decode on a worker thread so the first screen shows up right away. At
+  // most a few chunks are in flight, the GUI thread releases a slot after
+  // appending each one.
+  loader = std::thread([this, path, compression = compression] {
+    auto stream = OpenDecompressingStream(
+        compression, std::make_unique<wxFileInputStream>(path));
+
+    std::vector<char> buffer(loadChunkSize);
+    std::size_t total = 0;
+    while (!cancelLoad) {
+      stream->Read(buffer.data(), buffer.size());
+      auto count = stream->LastRead();
+      if (count == 0) {
+        break;
+      }
+
+      // Stop before the text control runs out of positions
+      if (count > maxLoadSize - total) {
+        CallAfter([this] { OnLoadFinished(LoadResult::TooLarge); });
+        return;
+      }
+      total += count;
+
+      while (!loadSlots.try_acquire_for(std::chrono::milliseconds(100))) {
+        if (cancelLoad) {
+          return;
+        }
+      }
+
+      CallAfter([this, chunk = std::string(buffer.data(), count)] {
+        OnLoadedChunk(chunk);
+      });
+    }
+
+    bool success = stream->GetLastError() == wxSTREAM_NO_ERROR ||
+                   stream->GetLastError() == wxSTREAM_EOF;
+    CallAfter([this, success] {
+      OnLoadFinished(success ? LoadResult::Complete : LoadResult::Failed);
+    });
+  });
+}
+
+void Editor::LoadColumns() {
+  // The column view reads rows from the file on demand, the text control
+  // stays empty and read-only so the file is never saved over
+  columnViewOnly = true;
+  textCtrl->SetReadOnly(true);
+
+  columnView = new ColumnView(this, path);
+  GetSizer()->Add(columnView, 1, wxEXPAND);
+  ShowView(columnView);
+}
+
+void Editor::StopLoading() {
+  cancelLoad = true;
+  if (loader.joinable()) {
+    loader.join();
+  }
+}
+
+void Editor::OnLoadedChunk(const std::string &chunk) {
+  textCtrl->SetReadOnly(false);
+  textCtrl->AppendTextRaw(chunk.data(), static_cast<int>(chunk.size()));
+  textCtrl->SetReadOnly(true);
+  loadSlots.release();
+}
+
+void Editor::OnLoadFinished(LoadResult result) {
+  if (loader.joinable()) {
+    loader.join();
+  }
+
+  loading = false;
+  recordUndo = true;
+  undoHistory.Clear();
+
+  // Only part of the file was loaded, keep it read-only and never save it
+  // back over the original
+  truncated = result != LoadResult::Complete;
+  textCtrl->SetReadOnly(truncated);
+
+  if (result == LoadResult::Failed) {
+    wxMessageBox(wxT("The file could not be fully decompressed, the part ")
+                     wxT("that was decoded is shown read-only"),
+                 wxT("Open File"), wxOK | wxICON_ERROR);
+  } else if (result == LoadResult::TooLarge) {
+    auto message = wxString::Format(
+        wxT("The file is too large to edit, only the first %s are shown"),
+        wxFileName::GetHumanReadableSize(
+            wxULongLong(textCtrl->GetLength())));
+    wxMessageBox(message, wxT("Open File"), wxOK | wxICON_ERROR);
+  }
+}
+
+bool Editor::WriteFile(const std::string &path) {
+  if (compression == Compression::None || !recompressOnSave) {
+    return textCtrl->SaveFile(path);
+  }
+
+  auto stream = OpenCompressingStream(
+      compression, std::make_unique<wxFileOutputStream>(path));
+  if (!stream || !stream->IsOk()) {
+    return false;
+  }
+
+  auto text = textCtrl->GetTextRaw();
+  stream->Write(text.data(), text.length());
+  return stream->Close();
 }
 
 void Editor::Save() {
+  if (loading || truncated || columnViewOnly) {
+    return;
+  }
+
   if (path.empty()) {
     auto newPath = ShowSaveFileDialog();
     if (!newPath) {
@@ -43,20 +223,114 @@ void Editor::Save() {
     path = newPath.value();
   }
 
-  textCtrl->SaveFile(path);
+  if (WriteFile(path)) {
+    undoHistory.SetSavePoint();
+    DiscardColumnView();
+  }
 }
 
 void Editor::SaveAs() {
+  if (loading || truncated || columnViewOnly) {
+    return;
+  }
+
   auto newPath = ShowSaveFileDialog();
   if (!newPath) {
     return;
   }
 
   path = newPath.value();
-  textCtrl->SaveFile(path);
+  compression = CompressionFromExtension(path);
+  if (!IsCompressionSupported(compression)) {
+    compression = Compression::None;
+  }
+
+  if (WriteFile(path)) {
+    undoHistory.SetSavePoint();
+    DiscardColumnView();
+  }
+}
+
+void Editor::ShowColumnView(bool show) {
+  if (show == IsColumnViewShown() || columnViewOnly) {
+    return;
+  }
+
+  if (show) {
+    // The column view reads straight from the file on disk
+    if (path.empty() || IsModified() || loading ||
+        compression != Compression::None) {
+      wxMessageBox(wxT("Column view needs an uncompressed file saved to disk"),
+                   wxT("Column View"), wxOK | wxICON_INFORMATION);
+      return;
+    }
+
+    if (!columnView) {
+      columnView = new ColumnView(this, path);
+      GetSizer()->Add(columnView, 1, wxEXPAND);
+    }
+  }
+
+  ShowView(show ? static_cast<wxWindow *>(columnView) : textCtrl);
+}
+
+bool Editor::IsColumnViewShown() const {
+  return columnView && columnView->IsShown();
+}
+
+void Editor::ShowWrapView(bool show, bool prettyPrint) {
+  if (!show) {
+    if (IsWrapViewShown(prettyPrint)) {
+      ShowView(textCtrl);
+    }
+    return;
+  }
+
+  if (loading || columnViewOnly || IsWrapViewShown(prettyPrint)) {
+    return;
+  }
+
+  // The view reads the document in place instead of copying it. Editing is
+  // disabled while it is shown (see IsTextShown) and it is destroyed when
+  // hidden, so the text cannot change under it.
+  ShowView(textCtrl);
+  std::string_view text(textCtrl->GetCharacterPointer(),
+                        textCtrl->GetLength());
+  wrapView = new WrapView(this, text, prettyPrint);
+  GetSizer()->Add(wrapView, 1, wxEXPAND);
+  ShowView(wrapView);
+}
+
+bool Editor::IsWrapViewShown(bool prettyPrint) const {
+  return wrapView && wrapView->IsPrettyPrinted() == prettyPrint;
+}
+
+bool Editor::IsTextShown() const { return textCtrl->IsShown(); }
+
+void Editor::ShowView(wxWindow *view) {
+  textCtrl->Show(view == textCtrl);
+
+  if (columnView) {
+    columnView->Show(view == columnView);
+  }
+
+  if (wrapView && view != wrapView) {
+    wrapView->Destroy();
+    wrapView = nullptr;
+  }
+
+  Layout();
 }
 
-bool Editor::IsModified() { return textCtrl->GetModify(); }
+void Editor::DiscardColumnView() {
+  // The index no longer matches the file once it has been overwritten
+  if (columnView && !columnView->IsShown()) {
+    columnView->Destroy();
+    columnView = nullptr;
+  }
+}
+
+bool Editor::IsModified() { return !undoHistory.IsSavePoint(); }
 
 std::string Editor::GetTitle() {
   if (path.empty()) {
@@ -82,13 +356,104 @@ std::optional<std::string> Editor::ShowSaveFileDialog() {
   return saveFileDialog.GetPath().ToStdString();
 }
 
-void Editor::Paste() { textCtrl->Paste(); }
-void Editor::Copy() { textCtrl->Copy(); }
-void Editor::Cut() { textCtrl->Cut(); }
-void Editor::Undo() { textCtrl->Undo(); }
-void Editor::Redo() { textCtrl->Redo(); }
+// Editing commands only apply to the text control, not to the read-only
+// column and wrap views shown in its place
+void Editor::Paste() {
+  if (IsTextShown()) {
+    textCtrl->Paste();
+  }
+}
+
+void Editor::Copy() {
+  if (IsTextShown()) {
+    textCtrl->Copy();
+  }
+}
+
+void Editor::Cut() {
+  if (IsTextShown()) {
+    textCtrl->Cut();
+  }
+}
+
+void Editor::Undo() {
+  if (!IsTextShown()) {
+    return;
+  }
+
+  if (auto step = undoHistory.Undo()) {
+    ApplyUndoStep(step.value(), true);
+  }
+}
+
+void Editor::Redo() {
+  if (!IsTextShown()) {
+    return;
+  }
+
+  if (auto step = undoHistory.Redo()) {
+    ApplyUndoStep(step.value(), false);
+  }
+}
+
+void Editor::ApplyUndoStep(const UndoHistory::Step &step, bool undo) {
+  using Kind = UndoHistory::Change::Kind;
+
+  recordUndo = false;
+  int caret = textCtrl->GetCurrentPos();
+
+  auto apply = [&](const UndoHistory::Change &change, bool insert) {
+    auto length = static_cast<int>(change.text.size());
+    if (insert) {
+      // Raw bytes with an explicit length, so text that is not valid UTF-8
+      // or contains NULs comes back unchanged
+      textCtrl->SetCurrentPos(change.position);
+      textCtrl->SetAnchor(change.position);
+      textCtrl->AddTextRaw(change.text.data(), length);
+      caret = change.position + length;
+    } else {
+      textCtrl->DeleteRange(change.position, length);
+      caret = change.position;
+    }
+  };
+
+  // Undo reverts the changes last to first, redo replays them in order
+  if (undo) {
+    for (auto it = step.rbegin(); it != step.rend(); ++it) {
+      apply(*it, it->kind == Kind::Delete);
+    }
+  } else {
+    for (const auto &change : step) {
+      apply(change, change.kind == Kind::Insert);
+    }
+  }
+
+  recordUndo = true;
+
+  textCtrl->GotoPos(caret);
+}
+
+void Editor::SetUndoMemoryBudget(std::size_t bytes) {
+  undoHistory.SetBudget(bytes);
+}
+
+std::size_t Editor::GetUndoMemoryBudget() const {
+  return undoHistory.GetBudget();
+}
+
+std::size_t Editor::GetUndoMemoryUsage() const {
+  return undoHistory.GetMemoryUsage();
+}
+
+std::size_t Editor::GetUndoSpilledBytes() const {
+  return undoHistory.GetSpilledBytes();
+}
 
 void Editor::Find() {
+  if (!IsTextShown()) {
+    return;
+  }
+
   if (findDialog) {
     findDialog->SetFocus();
     return;
@@ -103,6 +468,10 @@ void Editor::Find() {
 }
 
 void Editor::Replace() {
+  if (!IsTextShown()) {
+    return;
+  }
+
   if (replaceDialog) {
     replaceDialog->SetFocus();
     return;
@@ -146,11 +515,16 @@ static int FindDialogEventFlagsToSearchFlags(int flags) {
 void Editor::DoFindReplace(int searchFlags, const std::string &findText,
                            bool next, bool replace,
                            const std::string &replaceText, bool replaceAll) {
+  // A dialog left open can still fire while another view is shown
+  if (!IsTextShown()) {
+    return;
+  }
+
   textCtrl->SetSearchFlags(searchFlags);
 
   if (replaceAll) {
     int count = 0;
-    textCtrl->BeginUndoAction();
+    undoHistory.BeginGroup();
 
     // Start from the beginning of the document
     textCtrl->SetTargetStart(0);
@@ -169,7 +543,7 @@ void Editor::DoFindReplace(int searchFlags, const std::string &findText,
       pos = textCtrl->SearchInTarget(findText);
     }
 
-    textCtrl->EndUndoAction();
+    undoHistory.EndGroup();
 
     wxString message = wxString::Format(wxT("Replaced %d occurrences"), count);
     wxMessageBox(message, wxT("Replace All"), wxOK | wxICON_INFORMATION);
@@ -189,7 +563,9 @@ void Editor::DoFindReplace(int searchFlags, const std::string &findText,
   if (pos >= 0) {
     textCtrl->SetSelection(pos, pos + findText.length());
     if (replace) {
+      undoHistory.BeginGroup();
       textCtrl->ReplaceSelection(replaceText);
+      undoHistory.EndGroup();
       textCtrl->SetSelection(pos, pos + replaceText.length());
     }
     textCtrl->EnsureCaretVisible();
@@ -204,7 +580,9 @@ void Editor::DoFindReplace(int searchFlags, const std::string &findText,
   if (pos >= 0) {
     textCtrl->SetSelection(pos, pos + findText.length());
     if (replace) {
+      undoHistory.BeginGroup();
       textCtrl->ReplaceSelection(replaceText);
+      undoHistory.EndGroup();
       textCtrl->SetSelection(pos, pos + replaceText.length());
     }
     textCtrl->EnsureCaretVisible();
@@ -249,14 +627,56 @@ void Editor::OnFindReplaceAll(wxFindDialogEvent &event) {
 void Editor::OnCaretPositionChanged(wxStyledTextEvent &event) {
   int pos = textCtrl->GetCurrentPos();
   int line = textCtrl->LineFromPosition(pos);
-  int col = textCtrl->GetColumn(pos);
+  int col = columnCache.GetColumn(pos);
 
   auto statusEvent = new wxCommandEvent(wxEVT_COMMAND_TEXT_UPDATED, GetId());
 
   statusEvent->SetInt(line + 1);
   statusEvent->SetExtraLong(col + 1);
+  statusEvent->SetEventObject(this);
 
   wxQueueEvent(GetParent(), statusEvent);
 
+  // Changes made by a single user command are reported before the UI update,
+  // so this is where one undo step ends and the next one begins
+  undoHistory.Seal();
+
+  event.Skip();
+}
+
+void Editor::OnChange(wxStyledTextEvent &event) {
+  // Appending a file that is still loading is not a user modification
+  if (!loading) {
+    event.Skip();
+  }
+}
+
+void Editor::OnModified(wxStyledTextEvent &event) {
   event.Skip();
+
+  auto type = event.GetModificationType();
+  if (type & (wxSTC_MOD_INSERTTEXT | wxSTC_MOD_DELETETEXT)) {
+    columnCache.Invalidate(event.GetPosition(), event.GetLinesAdded() != 0);
+  }
+
+  if (!recordUndo) {
+    return;
+  }
+
+  auto pos = event.GetPosition();
+  auto length = event.GetLength();
+
+  // With undo collection off Scintilla does not report the deleted text, so
+  // it is read from the document while it is still there
+  if (type & wxSTC_MOD_BEFOREDELETE) {
+    auto text = textCtrl->GetTextRangeRaw(pos, pos + length);
+    deletedText.assign(text.data(), text.length());
+  } else if (type & wxSTC_MOD_INSERTTEXT) {
+    auto text = textCtrl->GetTextRangeRaw(pos, pos + length);
+    undoHistory.Record(UndoHistory::Change::Kind::Insert, pos,
+                       std::string(text.data(), text.length()));
+  } else if (type & wxSTC_MOD_DELETETEXT) {
+    undoHistory.Record(UndoHistory::Change::Kind::Delete, pos, deletedText);
+    deletedText.clear();
+  }
 }
@@ -0,0 +1,647 @@
+#include "FieldIndex.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Size of the blocks read from the file by each worker
+static constexpr std::size_t readBlockSize = 8 * 1024 * 1024;
+
+// Text sort keys are addressed by the worker that read them in the bits
+// above this and the offset in that worker's buffer below
+static constexpr int sortWorkerShift = 48;
+
+static std::string_view TrimLine(std::string_view line) {
+  while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+    line.remove_suffix(1);
+  }
+  return line;
+}
+
+// Calls fn with the offset and text of every line in [begin, end) of the
+// file, begin must be the start of a line
+template <typename Fn>
+static bool ForEachLine(std::ifstream &file, std::uint64_t begin,
+                        std::uint64_t end, const std::atomic<bool> &cancel,
+                        Fn fn) {
+  file.clear();
+  file.seekg(begin);
+
+  std::vector<char> block(readBlockSize);
+  std::string carry;
+  std::uint64_t offset = begin; // Offset of the start of carry
+  std::uint64_t pos = begin;
+
+  while (pos < end && !cancel) {
+    auto wanted = std::min<std::uint64_t>(block.size(), end - pos);
+    file.read(block.data(), wanted);
+    auto count = file.gcount();
+    if (count <= 0) {
+      break;
+    }
+
+    pos += count;
+    carry.append(block.data(), count);
+
+    std::size_t lineStart = 0;
+    for (auto newline = carry.find('\n'); newline != std::string::npos;
+         newline = carry.find('\n', lineStart)) {
+      std::string_view line(carry.data() + lineStart, newline - lineStart);
+      fn(offset + lineStart, TrimLine(line));
+      lineStart = newline + 1;
+    }
+
+    carry.erase(0, lineStart);
+    offset += lineStart;
+  }
+
+  if (cancel) {
+    return false;
+  }
+
+  if (!carry.empty()) {
+    fn(offset, TrimLine(carry));
+  }
+
+  return true;
+}
+
+static std::size_t SkipSpace(std::string_view text, std::size_t i) {
+  while (i < text.size() && (text[i] == ' ' || text[i] == '\t')) {
+    i++;
+  }
+  return i;
+}
+
+// i is at the opening quote, returns the position after the closing one
+static std::size_t SkipJsonString(std::string_view text, std::size_t i) {
+  for (i++; i < text.size(); i++) {
+    if (text[i] == '\\') {
+      i++;
+    } else if (text[i] == '"') {
+      return i + 1;
+    }
+  }
+  return text.size();
+}
+
+static std::size_t SkipJsonValue(std::string_view text, std::size_t i) {
+  if (i < text.size() && text[i] == '"') {
+    return SkipJsonString(text, i);
+  }
+
+  int depth = 0;
+  while (i < text.size()) {
+    auto c = text[i];
+    if (c == '"') {
+      i = SkipJsonString(text, i);
+      continue;
+    }
+    if (c == '{' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (depth == 0) {
+        break;
+      }
+      if (--depth == 0) {
+        return i + 1;
+      }
+    } else if (c == ',' && depth == 0) {
+      break;
+    }
+    i++;
+  }
+  return i;
+}
+
+static void AppendUtf8(std::string &out, unsigned int code) {
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xc0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  } else {
+    out += static_cast<char>(0xe0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code & 0x3f));
+  }
+}
+
+// Takes a quoted JSON string and returns its contents
+static std::string UnescapeJsonString(std::string_view text) {
+  std::string out;
+  for (std::size_t i = 1; i < text.size() && text[i] != '"'; i++) {
+    if (text[i] != '\\' || i + 1 >= text.size()) {
+      out += text[i];
+      continue;
+    }
+
+    switch (text[++i]) {
+    case 'n':
+      out += '\n';
+      break;
+    case 't':
+      out += '\t';
+      break;
+    case 'r':
+      out += '\r';
+      break;
+    case 'b':
+      out += '\b';
+      break;
+    case 'f':
+      out += '\f';
+      break;
+    case 'u':
+      if (i + 4 < text.size()) {
+        std::string hex(text.substr(i + 1, 4));
+        AppendUtf8(out, std::strtoul(hex.c_str(), nullptr, 16));
+        i += 4;
+      }
+      break;
+    default:
+      out += text[i];
+      break;
+    }
+  }
+  return out;
+}
+
+// Calls fn with the key and value offset of each member of a JSON object
+template <typename Fn>
+static void ForEachJsonMember(std::string_view line, Fn fn) {
+  auto i = SkipSpace(line, 0);
+  if (i >= line.size() || line[i] != '{') {
+    return;
+  }
+
+  for (i++;;) {
+    i = SkipSpace(line, i);
+    if (i >= line.size() || line[i] != '"') {
+      return;
+    }
+
+    auto keyEnd = SkipJsonString(line, i);
+    auto key = UnescapeJsonString(line.substr(i, keyEnd - i));
+
+    i = SkipSpace(line, keyEnd);
+    if (i >= line.size() || line[i] != ':') {
+      return;
+    }
+
+    i = SkipSpace(line, i + 1);
+    fn(key, i);
+
+    i = SkipSpace(line, SkipJsonValue(line, i));
+    if (i >= line.size() || line[i] != ',') {
+      return;
+    }
+    i++;
+  }
+}
+
+// Calls fn with the offset of each field of a delimited line. With quoting,
+// a quote at the start of a field quotes it up to the matching quote ("" is
+// an escaped quote), quotes anywhere else are plain characters.
+template <typename Fn>
+static void ForEachDelimitedField(std::string_view line, char delimiter,
+                                  bool quoting, Fn fn) {
+  for (std::size_t start = 0;;) {
+    fn(start);
+
+    auto i = start;
+    if (quoting && i < line.size() && line[i] == '"') {
+      for (i++; i < line.size(); i++) {
+        if (line[i] != '"') {
+          continue;
+        }
+        if (i + 1 < line.size() && line[i + 1] == '"') {
+          i++;
+        } else {
+          break;
+        }
+      }
+    }
+
+    i = line.find(delimiter, i);
+    if (i == std::string_view::npos) {
+      return;
+    }
+    start = i + 1;
+  }
+}
+
+std::optional<FieldIndex::Format>
+FieldIndex::FormatFromExtension(const std::string &path) {
+  auto pos = path.find_last_of('.');
+  auto extension = pos == std::string::npos ? "" : path.substr(pos + 1);
+
+  if (extension == "tsv" || extension == "tab") {
+    return Format::Tsv;
+  }
+  if (extension == "jsonl" || extension == "ndjson") {
+    return Format::JsonLines;
+  }
+  if (extension == "csv") {
+    return Format::Csv;
+  }
+
+  return std::nullopt;
+}
+
+FieldIndex::Format FieldIndex::DetectFormat(const std::string &path) {
+  if (auto format = FormatFromExtension(path)) {
+    return format.value();
+  }
+
+  // Guess from the first line
+  std::ifstream file(path, std::ios::binary);
+  std::string line;
+  std::getline(file, line);
+
+  if (line.starts_with('{')) {
+    return Format::JsonLines;
+  }
+  if (line.find('\t') != std::string::npos) {
+    return Format::Tsv;
+  }
+  return Format::Csv;
+}
+
+std::size_t FieldIndex::GetWorkerCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::size_t FieldIndex::GetRowCount() const {
+  return rowOffsets.empty() ? 0 : rowOffsets.size() - 1;
+}
+
+bool FieldIndex::Build(const std::string &path, Format format,
+                       const std::atomic<bool> &cancel) {
+  this->path = path;
+  this->format = format;
+  rowOffsets.clear();
+  columns.clear();
+  columnsByKey.clear();
+
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+
+  std::uint64_t size = file.tellg();
+  file.seekg(0);
+
+  std::string header;
+  std::getline(file, header);
+  ParseHeader(TrimLine(header));
+
+  // The header of a JSON lines file is also its first row
+  std::uint64_t dataStart = 0;
+  if (format != Format::JsonLines) {
+    dataStart = std::min<std::uint64_t>(header.size() + 1, size);
+  }
+
+  // Split the file into ranges that start at the beginning of a line
+  auto workerCount = GetWorkerCount();
+  std::vector<std::uint64_t> bounds{dataStart};
+  for (std::size_t i = 1; i < workerCount; i++) {
+    std::uint64_t pos = dataStart + (size - dataStart) * i / workerCount;
+    std::string skipped;
+    file.clear();
+    file.seekg(pos);
+    std::getline(file, skipped);
+    pos = std::min<std::uint64_t>(pos + skipped.size() + 1, size);
+    bounds.push_back(std::max(pos, bounds.back()));
+  }
+  bounds.push_back(size);
+
+  struct Partial {
+    std::vector<std::uint64_t> rows;
+    std::vector<std::vector<std::uint32_t>> starts;
+    bool complete = false;
+  };
+
+  std::vector<Partial> partials(workerCount);
+  std::vector<std::thread> workers;
+
+  for (std::size_t i = 0; i < workerCount; i++) {
+    workers.emplace_back([&, i] {
+      auto &partial = partials[i];
+      partial.starts.resize(columns.size());
+      std::vector<std::uint32_t> fields;
+
+      std::ifstream input(path, std::ios::binary);
+      partial.complete = ForEachLine(
+          input, bounds[i], bounds[i + 1], cancel,
+          [&](std::uint64_t offset, std::string_view line) {
+            if (line.empty()) {
+              return;
+            }
+            partial.rows.push_back(offset);
+            ParseRow(line, fields, partial.starts);
+          });
+    });
+  }
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  for (auto &partial : partials) {
+    if (!partial.complete) {
+      return false;
+    }
+
+    rowOffsets.insert(rowOffsets.end(), partial.rows.begin(),
+                      partial.rows.end());
+    for (std::size_t column = 0; column < columns.size(); column++) {
+      auto &starts = columns[column].starts;
+      starts.insert(starts.end(), partial.starts[column].begin(),
+                    partial.starts[column].end());
+    }
+
+    // Release each partial as soon as it has been merged
+    partial = {};
+  }
+
+  rowOffsets.push_back(size);
+  return true;
+}
+
+void FieldIndex::ParseHeader(std::string_view line) {
+  if (format == Format::JsonLines) {
+    ForEachJsonMember(line, [&](const std::string &key, std::size_t) {
+      if (columnsByKey.try_emplace(key, columns.size()).second) {
+        columns.push_back({key, {}});
+      }
+    });
+    return;
+  }
+
+  auto delimiter = format == Format::Tsv ? '\t' : ',';
+  auto quoting = format == Format::Csv;
+  ForEachDelimitedField(line, delimiter, quoting, [&](std::size_t start) {
+    columns.push_back({ExtractValue(line.substr(start)), {}});
+  });
+}
+
+void FieldIndex::ParseRow(
+    std::string_view line, std::vector<std::uint32_t> &fields,
+    std::vector<std::vector<std::uint32_t>> &starts) const {
+  fields.assign(columns.size(), missing);
+
+  if (format == Format::JsonLines) {
+    ForEachJsonMember(line, [&](const std::string &key, std::size_t start) {
+      auto column = columnsByKey.find(key);
+      if (column != columnsByKey.end()) {
+        fields[column->second] = start;
+      }
+    });
+  } else {
+    auto delimiter = format == Format::Tsv ? '\t' : ',';
+    auto quoting = format == Format::Csv;
+    std::size_t column = 0;
+    ForEachDelimitedField(line, delimiter, quoting, [&](std::size_t start) {
+      if (column < fields.size()) {
+        fields[column++] = start;
+      }
+    });
+  }
+
+  for (std::size_t column = 0; column < fields.size(); column++) {
+    starts[column].push_back(fields[column]);
+  }
+}
+
+std::string FieldIndex::ExtractValue(std::string_view text) const {
+  if (format == Format::JsonLines) {
+    if (text.starts_with('"')) {
+      return UnescapeJsonString(text.substr(0, SkipJsonString(text, 0)));
+    }
+
+    auto value = text.substr(0, SkipJsonValue(text, 0));
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+      value.remove_suffix(1);
+    }
+    return std::string(value);
+  }
+
+  // TSV has no quoting, quotes are part of the value
+  auto delimiter = format == Format::Tsv ? '\t' : ',';
+  if (format == Format::Tsv || !text.starts_with('"')) {
+    return std::string(text.substr(0, text.find(delimiter)));
+  }
+
+  // Quoted field, "" stands for a single quote
+  std::string value;
+  for (std::size_t i = 1; i < text.size(); i++) {
+    if (text[i] == '"') {
+      if (i + 1 >= text.size() || text[i + 1] != '"') {
+        break;
+      }
+      i++;
+    }
+    value += text[i];
+  }
+  return value;
+}
+
+std::string FieldIndex::ReadRow(std::ifstream &file, RowId row) const {
+  auto begin = rowOffsets[row];
+  auto end = rowOffsets[row + 1];
+
+  std::string text(end - begin, '\0');
+  file.clear();
+  file.seekg(begin);
+  file.read(text.data(), text.size());
+  text.resize(file.gcount());
+
+  text.resize(TrimLine(text).size());
+  return text;
+}
+
+std::string FieldIndex::GetField(std::string_view text, RowId row,
+                                 std::size_t column) const {
+  auto start = columns[column].starts[row];
+  if (start == missing || start > text.size()) {
+    return "";
+  }
+  return ExtractValue(text.substr(start));
+}
+
+void FieldIndex::ScanRows(
+    const std::function<void(std::size_t worker, RowId row,
+                             std::string_view text)> &fn,
+    const std::atomic<bool> &cancel) const {
+  auto rowCount = GetRowCount();
+  auto workerCount = std::min(GetWorkerCount(), std::max<std::size_t>(
+                                                    1, rowCount / 1024));
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < workerCount; i++) {
+    workers.emplace_back([&, i] {
+      RowId row = rowCount * i / workerCount;
+      RowId last = rowCount * (i + 1) / workerCount;
+      if (row == last) {
+        return;
+      }
+
+      // Blank lines between rows belong to no row and are skipped
+      std::ifstream file(path, std::ios::binary);
+      ForEachLine(file, rowOffsets[row], rowOffsets[last], cancel,
+                  [&](std::uint64_t offset, std::string_view line) {
+                    if (row < last && offset == rowOffsets[row]) {
+                      fn(i, row, line);
+                      row++;
+                    }
+                  });
+    });
+  }
+
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+std::vector<FieldIndex::RowId> FieldIndex::Filter(
+    const std::vector<std::pair<std::size_t, std::string>> &filters,
+    const std::atomic<bool> &cancel) const {
+  std::vector<std::vector<RowId>> matches(GetWorkerCount());
+
+  ScanRows(
+      [&](std::size_t worker, RowId row, std::string_view text) {
+        for (const auto &[column, needle] : filters) {
+          if (GetField(text, row, column).find(needle) == std::string::npos) {
+            return;
+          }
+        }
+        matches[worker].push_back(row);
+      },
+      cancel);
+
+  // Workers scan contiguous ranges, so concatenating keeps file order
+  std::vector<RowId> rows;
+  for (auto &part : matches) {
+    rows.insert(rows.end(), part.begin(), part.end());
+    part = {};
+  }
+  return rows;
+}
+
+void FieldIndex::Sort(std::vector<RowId> &rows, std::size_t column,
+                      bool ascending, const std::atomic<bool> &cancel) const {
+  // Only the sorted column is read into memory, as one 8 byte key per row
+  // in rows: the value itself for numbers, otherwise where its text is. Text
+  // goes into one buffer per worker, each value prefixed by its length.
+  std::vector<std::uint32_t> positions(GetRowCount(), missing);
+  for (std::size_t i = 0; i < rows.size(); i++) {
+    positions[rows[i]] = i;
+  }
+
+  std::vector<std::uint64_t> keys(rows.size());
+  std::vector<std::uint8_t> numeric(rows.size());
+  std::vector<std::string> texts(GetWorkerCount());
+  ScanRows(
+      [&](std::size_t worker, RowId row, std::string_view text) {
+        if (positions[row] == missing) {
+          return;
+        }
+
+        auto position = positions[row];
+        auto value = GetField(text, row, column);
+
+        char *end = nullptr;
+        auto number = std::strtod(value.c_str(), &end);
+        if (!value.empty() && *end == '\0') {
+          numeric[position] = true;
+          keys[position] = std::bit_cast<std::uint64_t>(number);
+          return;
+        }
+
+        auto &buffer = texts[worker];
+        keys[position] =
+            static_cast<std::uint64_t>(worker) << sortWorkerShift |
+            buffer.size();
+        auto length = static_cast<std::uint32_t>(value.size());
+        buffer.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        buffer += value;
+      },
+      cancel);
+
+  positions = {};
+  if (cancel) {
+    return;
+  }
+
+  auto textKey = [&](std::uint32_t i) {
+    const auto &buffer = texts[keys[i] >> sortWorkerShift];
+    auto offset = keys[i] & ((std::uint64_t{1} << sortWorkerShift) - 1);
+    std::uint32_t length = 0;
+    std::memcpy(&length, buffer.data() + offset, sizeof(length));
+    return std::string_view(buffer.data() + offset + sizeof(length), length);
+  };
+
+  // Numbers sort before text
+  auto less = [&](std::uint32_t a, std::uint32_t b) {
+    auto x = ascending ? a : b;
+    auto y = ascending ? b : a;
+    if (numeric[x] != numeric[y]) {
+      return numeric[x] > numeric[y];
+    }
+    if (numeric[x]) {
+      return std::bit_cast<double>(keys[x]) < std::bit_cast<double>(keys[y]);
+    }
+    return textKey(x) < textKey(y);
+  };
+
+  std::vector<std::uint32_t> order(rows.size());
+  for (std::size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+
+  // Sort one run per worker, then merge neighbouring runs
+  auto workerCount = std::min(GetWorkerCount(), std::max<std::size_t>(
+                                                    1, order.size() / 4096));
+  std::vector<std::size_t> bounds;
+  for (std::size_t i = 0; i <= workerCount; i++) {
+    bounds.push_back(order.size() * i / workerCount);
+  }
+
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < workerCount; i++) {
+    workers.emplace_back([&, i] {
+      std::stable_sort(order.begin() + bounds[i], order.begin() + bounds[i + 1],
+                       less);
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  while (bounds.size() > 2 && !cancel) {
+    std::vector<std::size_t> merged{bounds[0]};
+    for (std::size_t i = 0; i + 2 < bounds.size(); i += 2) {
+      std::inplace_merge(order.begin() + bounds[i],
+                         order.begin() + bounds[i + 1],
+                         order.begin() + bounds[i + 2], less);
+      merged.push_back(bounds[i + 2]);
+    }
+    if (bounds.size() % 2 == 0) {
+      merged.push_back(bounds.back());
+    }
+    bounds = std::move(merged);
+  }
+
+  if (cancel) {
+    return;
+  }
+
+  std::vector<RowId> sorted(rows.size());
+  for (std::size_t i = 0; i < order.size(); i++) {
+    sorted[i] = rows[order[i]];
+  }
+  rows = std::move(sorted);
+}
@@ -0,0 +1,66 @@
+#include "LineColumnCache.hpp"
+
+int LineColumnCache::CountColumns(int start, int end, int column) const {
+  auto text = textCtrl->GetRangePointer(start, end - start);
+  auto tabWidth = textCtrl->GetTabWidth();
+
+  for (int i = 0; i < end - start; i++) {
+    auto c = static_cast<unsigned char>(text[i]);
+    if (c == '\t') {
+      column = (column / tabWidth + 1) * tabWidth;
+    } else if ((c & 0xc0) != 0x80) {
+      // UTF-8 continuation bytes belong to the previous character
+      column++;
+    }
+  }
+
+  return column;
+}
+
+int LineColumnCache::GetColumn(int pos) {
+  auto currentLine = textCtrl->LineFromPosition(pos);
+  auto lineStart = textCtrl->PositionFromLine(currentLine);
+  auto lineEnd = textCtrl->GetLineEndPosition(currentLine);
+
+  if (lineEnd - lineStart < chunkSize) {
+    return textCtrl->GetColumn(pos);
+  }
+
+  if (currentLine != line) {
+    line = currentLine;
+    checkpoints.assign(1, 0);
+  }
+
+  auto chunk = static_cast<std::size_t>((pos - lineStart) / chunkSize);
+  while (checkpoints.size() <= chunk) {
+    auto start = lineStart + static_cast<int>(checkpoints.size() - 1) * chunkSize;
+    checkpoints.push_back(
+        CountColumns(start, start + chunkSize, checkpoints.back()));
+  }
+
+  auto chunkStart = lineStart + static_cast<int>(chunk) * chunkSize;
+  return CountColumns(chunkStart, pos, checkpoints[chunk]);
+}
+
+void LineColumnCache::Invalidate(int pos, bool linesChanged) {
+  if (line < 0) {
+    return;
+  }
+
+  if (linesChanged) {
+    line = -1;
+    checkpoints.clear();
+    return;
+  }
+
+  // Without new lines, changes elsewhere leave this line's offsets alone
+  if (textCtrl->LineFromPosition(pos) != line) {
+    return;
+  }
+
+  auto offset = pos - textCtrl->PositionFromLine(line);
+  auto valid = static_cast<std::size_t>(offset / chunkSize) + 1;
+  if (checkpoints.size() > valid) {
+    checkpoints.resize(valid);
+  }
+}
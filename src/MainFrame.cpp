@@ -1,7 +1,9 @@
 #include "MainFrame.hpp"
 #include "Editor.hpp"
 #include <vector>
+#include <wx/filename.h>
 #include <wx/notebook.h>
+#include <wx/numdlg.h>
 
 // clang-format off
 wxBEGIN_EVENT_TABLE(MainFrame, wxFrame)
@@ -12,6 +14,7 @@ wxBEGIN_EVENT_TABLE(MainFrame, wxFrame)
     EVT_MENU(wxID_EXIT, MainFrame::OnFileQuit)
     EVT_MENU(wxID_SAVE, MainFrame::OnFileSave)
     EVT_MENU(wxID_SAVEAS, MainFrame::OnFileSaveAs)
+    EVT_MENU(ID_FILE_RECOMPRESS, MainFrame::OnFileRecompress)
     EVT_MENU(wxID_UNDO, MainFrame::OnEditUndo)
     EVT_MENU(wxID_REDO, MainFrame::OnEditRedo)
     EVT_MENU(wxID_CUT, MainFrame::OnEditCut)
@@ -19,6 +22,12 @@ wxBEGIN_EVENT_TABLE(MainFrame, wxFrame)
     EVT_MENU(wxID_PASTE, MainFrame::OnEditPaste)
     EVT_MENU(wxID_FIND, MainFrame::OnEditFind)
     EVT_MENU(wxID_REPLACE, MainFrame::OnEditReplace)
+    EVT_MENU(ID_EDIT_UNDO_BUDGET, MainFrame::OnEditUndoBudget)
+    EVT_MENU(ID_EDIT_UNDO_PROCESS_BUDGET, MainFrame::OnEditUndoProcessBudget)
+    EVT_MENU(ID_VIEW_COLUMNS, MainFrame::OnViewColumns)
+    EVT_MENU(ID_VIEW_WRAP, MainFrame::OnViewWrap)
+    EVT_MENU(ID_VIEW_PRETTY_JSON, MainFrame::OnViewPrettyJson)
+    EVT_MENU_OPEN(MainFrame::OnMenuOpen)
     EVT_CLOSE(MainFrame::OnClose)
 wxEND_EVENT_TABLE();
 // clang-format on
@@ -31,6 +40,7 @@ void MainFrame::CreateFileMenu() {
   fileMenu->AppendSeparator();
   fileMenu->Append(wxID_SAVE);
   fileMenu->Append(wxID_SAVEAS);
+  fileMenu->AppendCheckItem(ID_FILE_RECOMPRESS, "&Recompress on Save");
   fileMenu->AppendSeparator();
   fileMenu->Append(wxID_CLOSE);
   // Problematic: wxWidgets bug?
@@ -50,15 +60,27 @@ void MainFrame::CreateEditMenu() {
   editMenu->AppendSeparator();
   editMenu->Append(wxID_FIND);
   editMenu->Append(wxID_REPLACE);
+  editMenu->AppendSeparator();
+  editMenu->Append(ID_EDIT_UNDO_BUDGET, "Undo &Memory Limit...");
+  editMenu->Append(ID_EDIT_UNDO_PROCESS_BUDGET, "&Total Undo Memory Limit...");
+}
+
+void MainFrame::CreateViewMenu() {
+  viewMenu = new wxMenu();
+  viewMenu->AppendCheckItem(ID_VIEW_COLUMNS, "&Column View\tCtrl+Shift+L");
+  viewMenu->AppendCheckItem(ID_VIEW_WRAP, "&Wrap Long Lines");
+  viewMenu->AppendCheckItem(ID_VIEW_PRETTY_JSON, "&Pretty Print JSON");
 }
 
 wxMenuBar *MainFrame::CreateMenuBar() {
   CreateFileMenu();
   CreateEditMenu();
+  CreateViewMenu();
 
   auto menuBar = new wxMenuBar();
   menuBar->Append(fileMenu, wxT("&File"));
   menuBar->Append(editMenu, wxT("&Edit"));
+  menuBar->Append(viewMenu, wxT("&View"));
 
   return menuBar;
 }
@@ -80,10 +102,10 @@ MainFrame::MainFrame() : wxFrame(nullptr, wxID_ANY, wxT("Ted")) {
   SetSizerAndFit(sizer);
   SetMinClientSize(wxSize(400, 300));
 
-  // Create status bar with three fields
-  CreateStatusBar(3);
-  int widths[] = {-1, 100, 150}; // -1 means variable width
-  SetStatusWidths(3, widths);
+  // Create status bar with four fields
+  CreateStatusBar(4);
+  int widths[] = {-1, 100, 150, 150}; // -1 means variable width
+  SetStatusWidths(4, widths);
 
   // Set initial status text
   SetStatusText(wxT("Ready"), 0);
@@ -136,6 +158,15 @@ void MainFrame::OnFileSaveAs([[maybe_unused]] wxCommandEvent &event) {
   notebook->SetPageText(index, editors[index]->GetTitle());
 }
 
+void MainFrame::OnFileRecompress(wxCommandEvent &event) {
+  auto index = notebook->GetSelection();
+  if (index == wxNOT_FOUND) {
+    return;
+  }
+
+  editors[index]->SetRecompressOnSave(event.IsChecked());
+}
+
 void MainFrame::OnFileClose([[maybe_unused]] wxCommandEvent &event) {
   auto index = notebook->GetSelection();
 
@@ -221,6 +252,89 @@ void MainFrame::OnEditReplace([[maybe_unused]] wxCommandEvent &event) {
   editors[index]->Replace();
 }
 
+void MainFrame::OnEditUndoBudget([[maybe_unused]] wxCommandEvent &event) {
+  auto index = notebook->GetSelection();
+  if (index == wxNOT_FOUND) {
+    return;
+  }
+
+  auto editor = editors[index];
+  auto megabytes = wxGetNumberFromUser(
+      wxT("Older undo history is compressed, then moved to a temporary ")
+          wxT("file, once it uses more memory than this."),
+      wxT("Megabytes:"), wxT("Undo Memory Limit"),
+      static_cast<long>(editor->GetUndoMemoryBudget() / (1024 * 1024)), 1,
+      65536, this);
+  if (megabytes < 0) {
+    return;
+  }
+
+  editor->SetUndoMemoryBudget(static_cast<std::size_t>(megabytes) * 1024 *
+                              1024);
+  UpdateUndoStatus(editor);
+}
+
+void MainFrame::OnEditUndoProcessBudget(
+    [[maybe_unused]] wxCommandEvent &event) {
+  auto megabytes = wxGetNumberFromUser(
+      wxT("Limit on the undo memory of all open files together."),
+      wxT("Megabytes:"), wxT("Total Undo Memory Limit"),
+      static_cast<long>(UndoHistory::GetProcessBudget() / (1024 * 1024)), 1,
+      65536, this);
+  if (megabytes < 0) {
+    return;
+  }
+
+  UndoHistory::SetProcessBudget(static_cast<std::size_t>(megabytes) * 1024 *
+                                1024);
+
+  // Re-applying each file's own limit trims its history to the new total
+  for (auto editor : editors) {
+    editor->SetUndoMemoryBudget(editor->GetUndoMemoryBudget());
+  }
+
+  auto index = notebook->GetSelection();
+  if (index != wxNOT_FOUND) {
+    UpdateUndoStatus(editors[index]);
+  }
+}
+
+void MainFrame::OnViewColumns(wxCommandEvent &event) {
+  auto index = notebook->GetSelection();
+  if (index == wxNOT_FOUND) {
+    return;
+  }
+
+  editors[index]->ShowColumnView(event.IsChecked());
+  SelectionChanged();
+}
+
+void MainFrame::OnViewWrap(wxCommandEvent &event) {
+  auto index = notebook->GetSelection();
+  if (index == wxNOT_FOUND) {
+    return;
+  }
+
+  editors[index]->ShowWrapView(event.IsChecked());
+  SelectionChanged();
+}
+
+void MainFrame::OnViewPrettyJson(wxCommandEvent &event) {
+  auto index = notebook->GetSelection();
+  if (index == wxNOT_FOUND) {
+    return;
+  }
+
+  editors[index]->ShowWrapView(event.IsChecked(), true);
+  SelectionChanged();
+}
+
+void MainFrame::OnMenuOpen(wxMenuEvent &event) {
+  // Editors change state on their own, e.g. when loading a file finishes
+  SelectionChanged();
+  event.Skip();
+}
+
 void MainFrame::OnSelectionChanged([[maybe_unused]] wxNotebookEvent &event) {
   SelectionChanged();
 
@@ -228,10 +342,12 @@ void MainFrame::OnSelectionChanged([[maybe_unused]] wxNotebookEvent &event) {
   int index = notebook->GetSelection();
   if (index != wxNOT_FOUND && index < static_cast<int>(editors.size())) {
     SetStatusText(editors[index]->GetTitle(), 0);
+    UpdateUndoStatus(editors[index]);
   } else {
     SetStatusText(wxT("Ready"), 0);
     SetStatusText(wxT("Ln: 1, Col: 1"), 1);
     SetStatusText(wxT("Text"), 2);
+    SetStatusText(wxEmptyString, 3);
   }
 
   event.Skip();
@@ -262,15 +378,41 @@ void MainFrame::SelectionChanged() {
 
   fileMenu->Enable(wxID_CLOSE, hasTab);
   fileMenu->Enable(wxID_CLOSE_ALL, hasTab);
-  fileMenu->Enable(wxID_SAVE, hasTab);
-  fileMenu->Enable(wxID_SAVEAS, hasTab);
-  editMenu->Enable(wxID_UNDO, hasTab);
-  editMenu->Enable(wxID_REDO, hasTab);
-  editMenu->Enable(wxID_COPY, hasTab);
-  editMenu->Enable(wxID_CUT, hasTab);
-  editMenu->Enable(wxID_PASTE, hasTab);
-  editMenu->Enable(wxID_FIND, hasTab);
-  editMenu->Enable(wxID_REPLACE, hasTab);
+
+  auto index = notebook->GetSelection();
+  Editor *editor = nullptr;
+  if (index != wxNOT_FOUND && index < static_cast<int>(editors.size())) {
+    editor = editors[index];
+  }
+
+  // Files opened in the column view only have no text to save or switch to
+  bool hasText = hasTab && !(editor && editor->IsColumnViewOnly());
+  // The column and wrap views are read-only
+  bool canEdit = editor && editor->IsTextShown();
+
+  bool canSave = hasText && !(editor && editor->IsTruncated());
+
+  fileMenu->Enable(wxID_SAVE, canSave);
+  fileMenu->Enable(wxID_SAVEAS, canSave);
+  fileMenu->Enable(ID_FILE_RECOMPRESS, editor && editor->IsCompressed());
+  fileMenu->Check(ID_FILE_RECOMPRESS,
+                  editor && editor->IsCompressed() &&
+                      editor->GetRecompressOnSave());
+  editMenu->Enable(wxID_UNDO, canEdit);
+  editMenu->Enable(wxID_REDO, canEdit);
+  editMenu->Enable(wxID_COPY, canEdit);
+  editMenu->Enable(wxID_CUT, canEdit);
+  editMenu->Enable(wxID_PASTE, canEdit);
+  editMenu->Enable(wxID_FIND, canEdit);
+  editMenu->Enable(wxID_REPLACE, canEdit);
+  editMenu->Enable(ID_EDIT_UNDO_BUDGET, editor != nullptr);
+  viewMenu->Enable(ID_VIEW_COLUMNS, hasText);
+  viewMenu->Enable(ID_VIEW_WRAP, hasText);
+  viewMenu->Enable(ID_VIEW_PRETTY_JSON, hasText);
+
+  viewMenu->Check(ID_VIEW_COLUMNS, editor && editor->IsColumnViewShown());
+  viewMenu->Check(ID_VIEW_WRAP, editor && editor->IsWrapViewShown());
+  viewMenu->Check(ID_VIEW_PRETTY_JSON, editor && editor->IsWrapViewShown(true));
 }
 
 std::optional<std::string> MainFrame::ShowOpenFileDialog() {
@@ -292,4 +434,22 @@ void MainFrame::OnEditorStatusUpdate(wxCommandEvent &event) {
 
   // Update language information
   SetStatusText(language, 2);
+
+  // Update undo memory information
+  auto editor = dynamic_cast<Editor *>(event.GetEventObject());
+  if (editor) {
+    UpdateUndoStatus(editor);
+  }
+}
+
+void MainFrame::UpdateUndoStatus(Editor *editor) {
+  auto undoText = wxT("Undo: ") + wxFileName::GetHumanReadableSize(
+                                       editor->GetUndoMemoryUsage());
+  if (editor->GetUndoSpilledBytes() > 0) {
+    undoText += wxT(" (+") +
+                wxFileName::GetHumanReadableSize(
+                    editor->GetUndoSpilledBytes()) +
+                wxT(" on disk)");
+  }
+  SetStatusText(undoText, 3);
 }
@@ -0,0 +1,471 @@
+#include "UndoHistory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <wx/mstream.h>
+#include <wx/zstream.h>
+
+// Roughly how much plain history goes into a single compressed block
+static constexpr std::size_t blockTargetSize = 256 * 1024;
+
+std::size_t UndoHistory::processBudget = UndoHistory::defaultProcessBudget;
+std::size_t UndoHistory::processUsage = 0;
+
+UndoHistory::UndoHistory() = default;
+
+UndoHistory::~UndoHistory() { Clear(); }
+
+void UndoHistory::SetProcessBudget(std::size_t bytes) { processBudget = bytes; }
+
+void UndoHistory::SetBudget(std::size_t bytes) {
+  budget = bytes;
+  Trim();
+}
+
+void UndoHistory::Account(std::size_t &counter, std::size_t add,
+                          std::size_t remove) {
+  counter = counter + add - remove;
+  processUsage = processUsage + add - remove;
+}
+
+std::size_t UndoHistory::ChangeSize(const Change &change) {
+  return sizeof(Change) + change.text.size();
+}
+
+std::size_t UndoHistory::StepSize(const Step &step) {
+  std::size_t size = sizeof(Step);
+  for (const auto &change : step) {
+    size += ChangeSize(change);
+  }
+  return size;
+}
+
+void UndoHistory::AddResident(const Step &step) {
+  Account(residentBytes, StepSize(step), 0);
+}
+
+void UndoHistory::RemoveResident(const Step &step) {
+  Account(residentBytes, 0, StepSize(step));
+}
+
+void UndoHistory::Record(Change::Kind kind, int position,
+                         const std::string &text) {
+  ClearRedo();
+
+  if (sealed && groupDepth == 0 && !undoSteps.empty() &&
+      savePoint != Depth()) {
+    // Coalesce typing into the previous step like Scintilla does
+    auto &last = undoSteps.back();
+    if (kind == Change::Kind::Insert && text.size() == 1 && text[0] != '\n' &&
+        last.size() == 1 && last[0].kind == Change::Kind::Insert &&
+        last[0].position + static_cast<int>(last[0].text.size()) == position) {
+      last[0].text += text;
+      Account(residentBytes, text.size(), 0);
+      return;
+    }
+  }
+
+  if (sealed || undoSteps.empty()) {
+    undoSteps.emplace_back();
+    AddResident(undoSteps.back());
+    sealed = false;
+  }
+
+  // Only account for the new change, a replace all can add thousands of
+  // changes to the same step
+  auto &step = undoSteps.back();
+  step.push_back({kind, position, text});
+  Account(residentBytes, ChangeSize(step.back()), 0);
+
+  Trim();
+}
+
+void UndoHistory::Seal() {
+  if (groupDepth == 0) {
+    sealed = true;
+  }
+}
+
+void UndoHistory::BeginGroup() {
+  if (groupDepth++ == 0) {
+    sealed = true;
+  }
+}
+
+void UndoHistory::EndGroup() {
+  if (groupDepth > 0 && --groupDepth == 0) {
+    sealed = true;
+  }
+}
+
+bool UndoHistory::CanUndo() const {
+  return !undoSteps.empty() || archivedSteps > 0;
+}
+
+bool UndoHistory::CanRedo() const {
+  return !redoSteps.empty() || !redoBlocks.empty();
+}
+
+std::optional<UndoHistory::Step> UndoHistory::Undo() {
+  sealed = true;
+
+  if (undoSteps.empty() && !RestoreUndo()) {
+    return std::nullopt;
+  }
+
+  auto step = std::move(undoSteps.back());
+  undoSteps.pop_back();
+  restoredUndo = std::min(restoredUndo, undoSteps.size());
+  redoSteps.push_back(step);
+
+  // Undoing deep into history moves it all to the redo side
+  Trim();
+  return step;
+}
+
+std::optional<UndoHistory::Step> UndoHistory::Redo() {
+  sealed = true;
+
+  if (redoSteps.empty() && !RestoreRedo()) {
+    return std::nullopt;
+  }
+
+  auto step = std::move(redoSteps.back());
+  redoSteps.pop_back();
+  restoredRedo = std::min(restoredRedo, redoSteps.size());
+  undoSteps.push_back(step);
+
+  Trim();
+  return step;
+}
+
+void UndoHistory::ClearRedo() {
+  if (redoSteps.empty() && redoBlocks.empty()) {
+    return;
+  }
+
+  for (const auto &step : redoSteps) {
+    RemoveResident(step);
+  }
+  redoSteps.clear();
+  restoredRedo = 0;
+  DropBlocks(redoBlocks);
+
+  // The saved state was somewhere in the discarded redo steps
+  if (savePoint && *savePoint > Depth()) {
+    savePoint.reset();
+  }
+}
+
+void UndoHistory::Clear() {
+  Account(residentBytes, 0, residentBytes);
+  Account(packedBytes, 0, packedBytes);
+
+  blocks.clear();
+  redoBlocks.clear();
+  archivedSteps = 0;
+  undoSteps.clear();
+  redoSteps.clear();
+  restoredUndo = 0;
+  restoredRedo = 0;
+  sealed = true;
+  groupDepth = 0;
+  savePoint = 0;
+
+  spilledBytes = 0;
+  CloseSpill();
+}
+
+void UndoHistory::SetSavePoint() {
+  savePoint = Depth();
+  sealed = true;
+}
+
+bool UndoHistory::IsSavePoint() const { return savePoint == Depth(); }
+
+bool UndoHistory::OverBudget(std::size_t percent) const {
+  return GetMemoryUsage() > budget / 100 * percent ||
+         processUsage > processBudget / 100 * percent;
+}
+
+void UndoHistory::Trim() {
+  if (!OverBudget(100)) {
+    return;
+  }
+
+  auto archive = [&](bool partial) {
+    if (Archive(redoSteps, redoBlocks, restoredRedo, partial) > 0) {
+      return true;
+    }
+    auto count = Archive(undoSteps, blocks, restoredUndo, partial);
+    archivedSteps += count;
+    return count > 0;
+  };
+
+  // Redo steps and the oldest undo steps are the furthest from the current
+  // state, so they are packed first. The step on either side of the current
+  // state stays uncompressed. Smaller runs are only packed if a very small
+  // budget cannot be met otherwise.
+  for (bool partial : {false, true}) {
+    auto percent = partial ? 100 : lowWaterPercent;
+    while (OverBudget(percent) && archive(partial)) {
+    }
+    while (OverBudget(percent) && (Spill(redoBlocks) || Spill(blocks))) {
+    }
+  }
+}
+
+// Steps are ordered from the furthest from the current state at the front
+// to the nearest at the back, blocks likewise
+std::size_t UndoHistory::Archive(std::deque<Step> &steps,
+                                 std::vector<Block> &target,
+                                 std::size_t &restored, bool partial) {
+  std::size_t count = 0;
+  std::size_t size = 0;
+  while (count + 1 < steps.size() && size < blockTargetSize) {
+    size += StepSize(steps[count]);
+    count++;
+  }
+
+  // Short runs compress poorly, and a run that is only the block restored
+  // last would be packed back unchanged
+  if (count == 0 ||
+      (!partial && (size < blockTargetSize || count <= restored))) {
+    return 0;
+  }
+
+  Block block{count, Pack(steps, count)};
+  Account(packedBytes, block.data.size(), 0);
+
+  for (std::size_t i = 0; i < count; i++) {
+    RemoveResident(steps.front());
+    steps.pop_front();
+  }
+  restored -= std::min(restored, count);
+
+  target.push_back(std::move(block));
+  return count;
+}
+
+bool UndoHistory::Spill(std::vector<Block> &source) {
+  auto block = std::find_if(source.begin(), source.end(),
+                            [](const Block &b) { return b.offset < 0; });
+  if (block == source.end()) {
+    return false;
+  }
+
+  if (!spillFile) {
+    spillFile = std::tmpfile();
+    if (!spillFile) {
+      return false;
+    }
+  }
+
+  auto length = block->data.size();
+  auto offset = AllocateSpill(length);
+  spilledBytes += length;
+  if (std::fseek(spillFile, offset, SEEK_SET) != 0 ||
+      std::fwrite(block->data.data(), 1, length, spillFile) != length) {
+    FreeSpill(offset, length);
+    return false;
+  }
+
+  Account(packedBytes, 0, length);
+  spillFileSize =
+      std::max(spillFileSize, static_cast<std::size_t>(offset) + length);
+
+  block->offset = offset;
+  block->length = length;
+  block->data.clear();
+  block->data.shrink_to_fit();
+  return true;
+}
+
+// Space of blocks read back from the spill file is reused, first fit
+long UndoHistory::AllocateSpill(std::size_t length) {
+  for (auto it = freeSpill.begin(); it != freeSpill.end(); ++it) {
+    if (it->second < length) {
+      continue;
+    }
+
+    auto [offset, available] = *it;
+    freeSpill.erase(it);
+    if (available > length) {
+      freeSpill.emplace(offset + static_cast<long>(length),
+                        available - length);
+    }
+    return offset;
+  }
+
+  auto offset = spillEnd;
+  spillEnd += static_cast<long>(length);
+  return offset;
+}
+
+void UndoHistory::FreeSpill(long offset, std::size_t length) {
+  spilledBytes -= length;
+
+  // Nothing left on disk, give the file back
+  if (spilledBytes == 0) {
+    CloseSpill();
+    return;
+  }
+
+  auto it = freeSpill.emplace(offset, length).first;
+
+  // Merge with the neighbouring free ranges
+  auto next = std::next(it);
+  if (next != freeSpill.end() &&
+      it->first + static_cast<long>(it->second) == next->first) {
+    it->second += next->second;
+    freeSpill.erase(next);
+  }
+  if (it != freeSpill.begin()) {
+    auto previous = std::prev(it);
+    if (previous->first + static_cast<long>(previous->second) == it->first) {
+      previous->second += it->second;
+      freeSpill.erase(it);
+      it = previous;
+    }
+  }
+
+  if (it->first + static_cast<long>(it->second) == spillEnd) {
+    spillEnd = it->first;
+    freeSpill.erase(it);
+  }
+}
+
+void UndoHistory::CloseSpill() {
+  if (spillFile) {
+    std::fclose(spillFile);
+    spillFile = nullptr;
+  }
+  spillFileSize = 0;
+  spillEnd = 0;
+  freeSpill.clear();
+}
+
+void UndoHistory::DropBlocks(std::vector<Block> &dropped) {
+  for (const auto &block : dropped) {
+    if (block.offset < 0) {
+      Account(packedBytes, 0, block.data.size());
+    } else {
+      FreeSpill(block.offset, block.length);
+    }
+  }
+  dropped.clear();
+}
+
+std::size_t UndoHistory::Restore(std::vector<Block> &source,
+                                 std::deque<Step> &steps) {
+  auto block = std::move(source.back());
+  source.pop_back();
+
+  if (block.offset >= 0) {
+    block.data.resize(block.length);
+    bool read = std::fseek(spillFile, block.offset, SEEK_SET) == 0 &&
+                std::fread(block.data.data(), 1, block.length, spillFile) ==
+                    block.length;
+    FreeSpill(block.offset, block.length);
+
+    if (!read) {
+      // Anything further away than this block is unreachable now
+      DropBlocks(source);
+      return 0;
+    }
+  } else {
+    Account(packedBytes, 0, block.data.size());
+  }
+
+  for (auto &step : Unpack(block.data)) {
+    AddResident(step);
+    steps.push_back(std::move(step));
+  }
+
+  return block.stepCount;
+}
+
+bool UndoHistory::RestoreUndo() {
+  if (blocks.empty()) {
+    return false;
+  }
+
+  auto count = Restore(blocks, undoSteps);
+  if (count == 0) {
+    archivedSteps = 0;
+    savePoint.reset();
+    return false;
+  }
+
+  archivedSteps -= count;
+  restoredUndo = count;
+  return true;
+}
+
+bool UndoHistory::RestoreRedo() {
+  if (redoBlocks.empty()) {
+    return false;
+  }
+
+  auto count = Restore(redoBlocks, redoSteps);
+  if (count == 0) {
+    if (savePoint && *savePoint > Depth()) {
+      savePoint.reset();
+    }
+    return false;
+  }
+
+  restoredRedo = count;
+  return true;
+}
+
+static void WriteValue(wxOutputStream &stream, std::uint64_t value) {
+  stream.Write(&value, sizeof(value));
+}
+
+static std::uint64_t ReadValue(wxInputStream &stream) {
+  std::uint64_t value = 0;
+  stream.Read(&value, sizeof(value));
+  return value;
+}
+
+std::string UndoHistory::Pack(const std::deque<Step> &steps,
+                              std::size_t count) {
+  wxMemoryOutputStream memory;
+  {
+    wxZlibOutputStream zlib(memory, wxZ_BEST_SPEED, wxZLIB_NO_HEADER);
+    WriteValue(zlib, count);
+    for (std::size_t i = 0; i < count; i++) {
+      WriteValue(zlib, steps[i].size());
+      for (const auto &change : steps[i]) {
+        WriteValue(zlib, static_cast<std::uint64_t>(change.kind));
+        WriteValue(zlib, static_cast<std::uint64_t>(change.position));
+        WriteValue(zlib, change.text.size());
+        zlib.Write(change.text.data(), change.text.size());
+      }
+    }
+  }
+
+  std::string data(memory.GetLength(), '\0');
+  memory.CopyTo(data.data(), data.size());
+  return data;
+}
+
+std::vector<UndoHistory::Step> UndoHistory::Unpack(const std::string &data) {
+  wxMemoryInputStream memory(data.data(), data.size());
+  wxZlibInputStream zlib(memory, wxZLIB_NO_HEADER);
+
+  std::vector<Step> steps(ReadValue(zlib));
+  for (auto &step : steps) {
+    step.resize(ReadValue(zlib));
+    for (auto &change : step) {
+      change.kind = static_cast<Change::Kind>(ReadValue(zlib));
+      change.position = static_cast<int>(ReadValue(zlib));
+      change.text.resize(ReadValue(zlib));
+      zlib.Read(change.text.data(), change.text.size());
+    }
+  }
+
+  return steps;
+}
@@ -0,0 +1,235 @@
+#include "WrapView.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+
+#include <wx/dcbuffer.h>
+
+// How often the worker loops check for cancellation
+static constexpr std::size_t cancelCheckInterval = 1024 * 1024;
+
+static std::size_t SkipSpace(std::string_view text, std::size_t i) {
+  while (i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) {
+    i++;
+  }
+  return i;
+}
+
+// Re-indents JSON (or several JSON values, one per line) with two spaces.
+// Malformed input is formatted as far as possible rather than rejected.
+static std::string PrettyPrintJson(std::string_view text,
+                                   const std::atomic<bool> &cancel) {
+  std::string out;
+  out.reserve(text.size() + text.size() / 4);
+
+  int indent = 0;
+  auto newline = [&] {
+    out += '\n';
+    out.append(indent * 2, ' ');
+  };
+
+  for (std::size_t i = 0; i < text.size(); i++) {
+    if (i % cancelCheckInterval == 0 && cancel) {
+      return "";
+    }
+
+    auto c = text[i];
+    switch (c) {
+    case '"': {
+      auto end = i + 1;
+      while (end < text.size() && text[end] != '"') {
+        end += text[end] == '\\' ? 2 : 1;
+      }
+      end = std::min(end + 1, text.size());
+      out.append(text.substr(i, end - i));
+      i = end - 1;
+      break;
+    }
+    case '{':
+    case '[': {
+      // Top level values each start on their own line
+      if (indent == 0 && !out.empty() && out.back() != '\n') {
+        out += '\n';
+      }
+
+      out += c;
+      auto next = SkipSpace(text, i + 1);
+      if (next < text.size() && (text[next] == '}' || text[next] == ']')) {
+        out += text[next];
+        i = next;
+      } else {
+        indent++;
+        newline();
+      }
+      break;
+    }
+    case '}':
+    case ']':
+      indent = std::max(0, indent - 1);
+      newline();
+      out += c;
+      break;
+    case ',':
+      out += c;
+      newline();
+      break;
+    case ':':
+      out += ": ";
+      break;
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+      break;
+    default:
+      out += c;
+      break;
+    }
+  }
+
+  return out;
+}
+
+// Returns the offset at which every row starts, wrapping at line breaks and
+// after wrapColumn characters
+static std::vector<std::size_t> BuildWrapIndex(std::string_view text,
+                                               std::size_t wrapColumn,
+                                               const std::atomic<bool> &cancel) {
+  std::vector<std::size_t> rowStarts{0};
+  std::size_t column = 0;
+
+  for (std::size_t i = 0; i < text.size(); i++) {
+    if (i % cancelCheckInterval == 0 && cancel) {
+      return {};
+    }
+
+    auto c = static_cast<unsigned char>(text[i]);
+    if (c == '\n') {
+      rowStarts.push_back(i + 1);
+      column = 0;
+      continue;
+    }
+
+    // UTF-8 continuation bytes stay with their character
+    if ((c & 0xc0) == 0x80) {
+      continue;
+    }
+
+    if (column == wrapColumn) {
+      rowStarts.push_back(i);
+      column = 0;
+    }
+    column++;
+  }
+
+  rowStarts.push_back(text.size());
+  return rowStarts;
+}
+
+WrapView::WrapView(wxWindow *parent, std::string_view text, bool prettyPrint,
+                   std::size_t wrapColumn)
+    : wxVScrolledWindow(parent, wxID_ANY), prettyPrint(prettyPrint),
+      wrapColumn(wrapColumn), source(text) {
+  SetFont(wxFontInfo(10).Family(wxFONTFAMILY_TELETYPE));
+  SetBackgroundStyle(wxBG_STYLE_PAINT);
+  rowHeight = GetCharHeight();
+
+  Bind(wxEVT_PAINT, &WrapView::OnPaint, this);
+  Bind(wxEVT_KEY_DOWN, &WrapView::OnKeyDown, this);
+
+  worker = std::thread([this] {
+    std::string formatted;
+    if (this->prettyPrint) {
+      formatted = PrettyPrintJson(source, cancelWorker);
+    }
+
+    auto rowStarts = BuildWrapIndex(this->prettyPrint ? formatted : source,
+                                    this->wrapColumn, cancelWorker);
+    if (cancelWorker) {
+      return;
+    }
+
+    pendingFormatted = std::move(formatted);
+    pendingRowStarts = std::move(rowStarts);
+    CallAfter(&WrapView::OnReady);
+  });
+}
+
+WrapView::~WrapView() {
+  cancelWorker = true;
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+wxCoord WrapView::OnGetRowHeight([[maybe_unused]] size_t row) const {
+  return rowHeight;
+}
+
+void WrapView::OnReady() {
+  if (worker.joinable()) {
+    worker.join();
+  }
+
+  formatted = std::move(pendingFormatted);
+  text = prettyPrint ? std::string_view(formatted) : source;
+  rowStarts = std::move(pendingRowStarts);
+  ready = true;
+
+  SetRowCount(rowStarts.size() - 1);
+  Refresh();
+}
+
+void WrapView::OnPaint([[maybe_unused]] wxPaintEvent &event) {
+  wxAutoBufferedPaintDC dc(this);
+  dc.SetBackground(wxBrush(wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOW)));
+  dc.SetTextForeground(wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOWTEXT));
+  dc.SetFont(GetFont());
+  dc.Clear();
+
+  if (!ready) {
+    dc.DrawText(prettyPrint ? wxT("Formatting...") : wxT("Wrapping..."), 4, 0);
+    return;
+  }
+
+  wxCoord y = 0;
+  for (auto row = GetVisibleRowsBegin(); row < GetVisibleRowsEnd(); row++) {
+    auto start = rowStarts[row];
+    auto end = rowStarts[row + 1];
+    while (end > start && (text[end - 1] == '\n' || text[end - 1] == '\r')) {
+      end--;
+    }
+
+    dc.DrawText(wxString::FromUTF8(text.data() + start, end - start), 4, y);
+    y += rowHeight;
+  }
+}
+
+void WrapView::OnKeyDown(wxKeyEvent &event) {
+  switch (event.GetKeyCode()) {
+  case WXK_UP:
+    ScrollRows(-1);
+    break;
+  case WXK_DOWN:
+    ScrollRows(1);
+    break;
+  case WXK_PAGEUP:
+    ScrollPages(-1);
+    break;
+  case WXK_PAGEDOWN:
+    ScrollPages(1);
+    break;
+  case WXK_HOME:
+    ScrollToRow(0);
+    break;
+  case WXK_END:
+    if (GetRowCount() > 0) {
+      ScrollToRow(GetRowCount() - 1);
+    }
+    break;
+  default:
+    event.Skip();
+    break;
+  }
+}